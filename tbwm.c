@@ -17,6 +17,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <errno.h>
 #include <stdarg.h>
 #include <wayland-server-core.h>
@@ -119,6 +120,92 @@ typedef struct {
 } Button;
 
 typedef struct Monitor Monitor;
+
+/* A scrolling title. The text is rasterized once into a strip one loop
+ * (text + 2 spaces) wider than the visible area; scrolling only moves the
+ * scene buffer's source box, so a tick costs no pixel work. */
+typedef struct {
+	struct wlr_scene_buffer *node;
+	struct TitleBuffer *buf;
+	uint32_t key;   /* hash of text, colors and font the strip was drawn with */
+	int loop_w;     /* pixel width of one loop */
+	int view_w;     /* visible width */
+	int shown;      /* counted in scrolling_titles and mon->scrolling */
+	Monitor *mon;   /* output counting it while shown */
+} Marquee;
+#define MAX_TAB_MARQUEES 32
+
+/* Text-atlas mode: one atlas per (fg, bg) holds the glyphs atlas_index()
+ * knows, uploaded once; text is cell nodes showing atlas source boxes. */
+#define ATLAS_COLS   32
+#define ATLAS_GLYPHS 351  /* see atlas_index() */
+#define ATLAS_MAX    8    /* color variants kept */
+typedef struct {
+	struct wl_list link;           /* glyph_atlases */
+	struct wlr_client_buffer *buf; /* carries the one texture every cell shares */
+	uint32_t fg, bg;
+	unsigned int font_serial;
+} GlyphAtlas;
+
+typedef struct {
+	struct wlr_scene_buffer *node;
+	struct wlr_buffer *shown;      /* atlas (or own) buffer the node shows */
+	struct TitleBuffer *own;       /* private cell for codepoints outside the atlas */
+	unsigned long cp;
+	uint32_t fg, bg;
+	unsigned int font_serial;
+} AtlasCell;
+
+typedef struct {
+	AtlasCell *cells;
+	int count, cap;                /* cells shown, allocated */
+} AtlasText;
+
+/* One independently cached piece of the status bar; its buffer is only
+ * redrawn when the key of what it shows changes. */
+typedef struct {
+	struct wlr_scene_buffer *node;
+	struct TitleBuffer *buf;
+	uint32_t key;   /* hash of content, colors, font and width buf was drawn with */
+	int x;          /* position in the bar */
+	int w;          /* width it was last placed with */
+} BarSeg;
+enum { SegMenu, SegTags, SegStatus, SegClock, SegLine, SegLast }; /* fixed bar segments */
+
+/* A run of box-drawing cells (first, mid..., last) shared by every frame
+ * that needs the same one. Frames hold a reference each; the buffer is
+ * dropped with the last one. */
+typedef struct {
+	struct wl_list link;    /* border_strips */
+	struct TitleBuffer *buf;
+	int vertical, len;      /* orientation and length in pixels */
+	unsigned long first, mid, last;
+	uint32_t fg, bg;
+	unsigned int font_serial;
+	int refs;
+} BorderStrip;
+
+/* Client.neighbors bits */
+#define NEIGHBOR_ABOVE (1 << 0)
+#define NEIGHBOR_BELOW (1 << 1)
+#define NEIGHBOR_LEFT  (1 << 2)
+#define NEIGHBOR_RIGHT (1 << 3)
+
+/* Everything that determines the pixels of a client's frame buffers.
+ * renderframe() compares this against the last drawn state and skips
+ * the raster when nothing changed. */
+typedef struct {
+	int width, height;
+	int cell_w, cell_h;
+	int focused;
+	int neighbors;      /* NEIGHBOR_* bits */
+	uint32_t title_hash;
+	uint32_t border_color, line_color;
+	int scroll_mode;
+	int text_atlas;
+	unsigned int font_serial;
+} FrameState;
+
 typedef struct {
 	/* Must keep this field first */
 	unsigned int type; /* XDGShell or X11* */
@@ -132,6 +219,7 @@ typedef struct {
 	struct wlr_scene_buffer *frame_right;
 	struct wl_list link;
 	struct wl_list flink;
+	struct wl_list mlink; /* Monitor.clients */
 	struct wlr_box geom; /* layout-relative, includes border */
 	struct wlr_box prev; /* layout-relative, includes border */
 	struct wlr_box bounds; /* only width and height are used */
@@ -163,13 +251,32 @@ typedef struct {
 	char prev_mon_name[64]; /* remember monitor name for VT switch restore */
 	DwindleNode *dwindle;    /* dwindle layout node (NULL if floating) */
 	int needs_title_scroll;  /* 1 if title overflows and needs scrolling */
-	/* Cached frame buffers for reuse (avoid per-frame allocation) */
+	/* Title strip is per-client; the other sides show shared strips over
+	 * background rects */
 	struct TitleBuffer *frame_top_buf;
-	struct TitleBuffer *frame_bottom_buf;
-	struct TitleBuffer *frame_left_buf;
-	struct TitleBuffer *frame_right_buf;
+	BorderStrip *frame_bottom_strip;
+	BorderStrip *frame_left_strip;
+	BorderStrip *frame_right_strip;
+	struct wlr_scene_rect *frame_left_bg;
+	struct wlr_scene_rect *frame_right_bg;
 	int frame_width;  /* cached dimensions to detect resize */
 	int frame_height;
+	FrameState frame_state; /* state the frame buffers were last drawn with */
+	int frame_state_valid;
+	int frame_dirty;        /* frame needs redrawing on the next output frame */
+	int neighbors;          /* NEIGHBOR_* edges shared with tiled windows, set by updateneighbors() */
+	Marquee title_marquee;  /* scrolling title in the top frame */
+	AtlasText title_text;   /* title cells in text-atlas mode */
+	struct wlr_box req_geom; /* geometry last passed to resize() */
+	unsigned int req_font_serial;
+	int req_valid;
+	/* State of the last configure resize() sent, to elide repeats */
+	struct wlr_box sized_geom;
+	struct wlr_box sized_clip;
+	unsigned int sized_font_serial;
+	int sized_fullscreen;
+	int sized_valid;
+	unsigned long configures_sent, configures_elided;
 } Client;
 
 typedef struct {
@@ -222,8 +329,8 @@ struct DwindleNode {
 	struct wlr_box box;        /* grid-aligned geometry */
 	int split_horizontal;      /* 1 = split left/right, 0 = split top/bottom */
 	float split_ratio;         /* 0.0-1.0, how much of space goes to children[0] */
-	uint32_t tags;
-	Monitor *mon;
+	uint32_t tags;             /* tree's monitor and tags, set when the node */
+	Monitor *mon;              /* joins it; unused while on the free list */
 };
 
 /* Text buffer for title bars - defined early for Monitor struct */
@@ -231,17 +338,63 @@ struct TitleBuffer {
 	struct wlr_buffer base;
 	void *data;
 	int stride;
+	size_t cap;           /* bytes of storage behind data (a pixstore class) */
+	struct wl_list link;  /* titlebuf_pool, while recycled */
 };
 
+/* One client's box from the geometry pass of arrange(); see layout_commit() */
+typedef struct {
+	Client *c;
+	struct wlr_box box;
+} LayoutSlot;
+
+/* A monitor's visible tiled windows sorted along both axes, rebuilt by
+ * updateneighbors() after every layout pass; see tileindex_dir() */
+typedef struct {
+	Client **by_x;  /* by left edge */
+	Client **by_y;  /* by top edge */
+	int n, cap;
+} TileIndex;
+
+/* One REPL history line, rasterized once and moved around by the scene graph */
+typedef struct {
+	struct wlr_scene_buffer *node;
+	struct TitleBuffer *buf;
+	unsigned long seq;  /* repl_line_seq of the line drawn into buf, 0 = none */
+} ReplStrip;
+
 struct Monitor {
 	struct wl_list link;
 	struct wlr_output *wlr_output;
 	struct wlr_scene_output *scene_output;
 	struct wlr_scene_rect *fullscreen_bg; /* See createmon() for info */
-	struct wlr_scene_buffer *bar; /* status bar / launcher */
-	struct wlr_scene_buffer *repl; /* rendered REPL output for this monitor */
-	struct TitleBuffer *bar_buf;  /* cached bar buffer for reuse */
-	int bar_width;                /* cached width to detect resize */
+	struct wlr_scene_tree *bar;   /* status bar / launcher: background + segments */
+	struct wlr_scene_rect *bar_bg;
+	BarSeg bar_seg[SegLast];
+	BarSeg *tab_segs;             /* one per window tab, grown as needed */
+	int tab_seg_cap;
+	struct wlr_scene_tree *repl;  /* REPL output for this monitor: background + line strips */
+	struct wlr_scene_rect *repl_bg;
+	struct wlr_scene_buffer *repl_more; /* scroll indicator cell */
+	struct TitleBuffer *repl_more_buf;
+	ReplStrip *repl_strips;       /* one strip per visible row, indexed by seq % repl_rows */
+	int repl_rows, repl_width, repl_cell_h;
+	int repl_dirty;               /* REPL needs redrawing on the next frame */
+	int bar_dirty;                /* bar needs redrawing on the next frame */
+	int clock_len;                /* length in cells of bar_seg[SegClock]; 0 = no clock */
+	int clock_dirty;              /* clock needs checking on the next frame */
+	enum wlr_scale_filter_mode ui_filter; /* for UI buffers on this output, see updateuifilter() */
+	Marquee tab_marquee[MAX_TAB_MARQUEES]; /* scrolling bar tab titles */
+	int tab_marquee_overflow;     /* more scrolling tabs than marquees; counted in scrolling_titles */
+	int scrolling;                /* this output's share of scrolling_titles, see scrollref() */
+	LayoutSlot *layout;           /* pending boxes from the current layout pass */
+	DwindleNode *dwindle_roots[32]; /* dwindle tree covering each tag bit, see dwindle_find_root() */
+	DwindleNode *split_drag;      /* split moved by a drag since the last frame, see dwindle_drag() */
+	TileIndex tiled;              /* visible tiled windows, see updateneighbors() */
+	struct wl_list clients;       /* Client.mlink, in the order of clients; see setmon() */
+	int tag_clients[32];          /* clients carrying each tag bit */
+	int nvisible, nvisible_tiled, nvisible_floating; /* on the current tagset, see clientcount() */
+	int layout_count, layout_cap;
 	struct wl_listener frame;
 	struct wl_listener destroy;
 	struct wl_listener request_state;
@@ -331,9 +484,14 @@ static void dwindle_remove(Client *c);
 static void dwindle_arrange(Monitor *m, uint32_t tags);
 static void dwindle_recalc(DwindleNode *node);
 static DwindleNode *dwindle_find_root(Monitor *m, uint32_t tags);
+static void dwindle_drag(Monitor *m);
 static void focusdir(const Arg *arg);
 static void swapdir(const Arg *arg);
 static Client *client_in_direction(Client *c, int dir);
+static int tileindex_reserve(TileIndex *ix, int n);
+static void tileindex_sort(TileIndex *ix);
+static void tileindex_remove(TileIndex *ix, Client *c);
+static Client *tileindex_dir(const TileIndex *ix, const Client *c, int dir);
 static void focusclient(Client *c, int lift);
 static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
@@ -348,21 +506,9 @@ static void file_debug_log(const char *fmt, ...);
 #define TBWM_LOG_WARN 2
 #define TBWM_LOG_ERROR 3
 static void tbwm_log(int level, const char *fmt, ...);
-
-/* Simple file logger for debugging when running in a graphical session */
-static void
-file_debug_log(const char *fmt, ...)
-{
-	FILE *f = fopen("/tmp/tbwm-debug.log", "a");
-	if (!f)
-		return;
-	va_list ap;
-	va_start(ap, fmt);
-	vfprintf(f, fmt, ap);
-	va_end(ap);
-	fflush(f);
-	fclose(f);
-}
+static void log_flush(void);
+static void log_line(int level, const char *msg, size_t len);
+static void wlr_log_cb(enum wlr_log_importance importance, const char *fmt, va_list args);
 
 static void incnmaster(const Arg *arg);
 static void inputdevice(struct wl_listener *listener, void *data);
@@ -379,6 +525,8 @@ static void motionabsolute(struct wl_listener *listener, void *data);
 static void motionnotify(uint32_t time, struct wlr_input_device *device, double sx,
 		double sy, double sx_unaccel, double sy_unaccel);
 static void motionrelative(struct wl_listener *listener, void *data);
+static void grabapply(void);
+static void grabqueue(struct wlr_box box);
 static void moveresize(const Arg *arg);
 static void outputmgrapply(struct wl_listener *listener, void *data);
 static void outputmgrapplyortest(struct wlr_output_configuration_v1 *config, int test);
@@ -416,25 +564,93 @@ static void spawn(const Arg *arg);
 static void buildappcache(void);
 static void render_char_to_buffer(uint32_t *pixels, int buf_w, int buf_h, int x, int y,
                       unsigned long charcode, uint32_t color);
-static void render_char_clipped(uint32_t *pixels, int buf_w, int buf_h, int x, int y,
-                    unsigned long charcode, uint32_t color, int clip_left, int clip_right);
+static void draw_cell(uint32_t *pixels, int buf_w, int buf_h, int x, int y,
+                      unsigned long charcode, uint32_t fg, uint32_t bg);
+static void draw_cell_clipped(uint32_t *pixels, int buf_w, int buf_h, int x, int y,
+                      unsigned long charcode, uint32_t fg, uint32_t bg, int clip_left, int clip_right);
+static void tile_cache_invalidate(void);
+static uint32_t *draw_scratch(int w, int h);
+static void buffer_commit(struct wlr_scene_buffer *node, struct TitleBuffer **slot, int w, int h);
+static struct TitleBuffer *titlebuf_create(int w, int h);
+static struct TitleBuffer *titlebuf_acquire(int w, int h);
+static void titlebuf_recycle(struct TitleBuffer *tb);
+static void titlebuf_pool_clear(void);
+static void marquee_count(Marquee *mq, Monitor *m);
+static void marquee_update(Marquee *mq, Monitor *m, struct wlr_scene_tree *parent,
+                      int x, int y, int view_w,
+                      const unsigned long *cps, int ncp, uint32_t fg, uint32_t bg);
+static void marquee_scroll(Marquee *mq);
+static void marquee_show(Marquee *mq, Monitor *m);
+static void marquee_hide(Marquee *mq);
+static void marquee_destroy(Marquee *mq);
 static unsigned long utf8_decode(const char *s, int *pos);
 static void updatebar(Monitor *m);
 static void updatebars(void);
 static void updateappmenu(void);
+static void renderbar(Monitor *m);
+static void destroybar(Monitor *m);
+static uint32_t *barseg_place(Monitor *m, BarSeg *s, int x, int w, uint32_t key);
+static void barseg_done(BarSeg *s);
+static void barseg_hide(BarSeg *s);
+static void barseg_fill(uint32_t *pixels, int w, uint32_t color);
+static int barseg_text(uint32_t *pixels, int w, int x, const char *str, int len,
+		uint32_t fg, uint32_t bg);
+static BarSeg *bartabseg(Monitor *m, int n);
+static void renderbarline(Monitor *m, int width);
+static int renderbarmenu(Monitor *m, int x);
+static int renderbartags(Monitor *m, int x);
+static int renderbartabs(Monitor *m, int x, int width, int *n_marquees);
+static void renderbarstatus(Monitor *m, int x, int width);
+static uint32_t frame_title_hash(const char *title);
+static int atlas_index(unsigned long cp);
+static GlyphAtlas *glyph_atlas_get(uint32_t fg, uint32_t bg);
+static void glyph_atlas_clear(void);
+static void atlastext_set(AtlasText *t, struct wlr_scene_tree *parent, int x, int y,
+		const unsigned long *cps, int n, uint32_t fg, uint32_t bg);
+static void atlastext_hide(AtlasText *t);
+static void atlastext_destroy(AtlasText *t);
+static void frame_title_atlas(Client *c, const char *title, int width, int focused);
+static BorderStrip *borderstrip_get(int vertical, int len, unsigned long first,
+		unsigned long mid, unsigned long last, uint32_t fg, uint32_t bg);
+static void borderstrip_put(BorderStrip *s);
+static void frame_set_side(Client *c, struct wlr_scene_buffer **node, BorderStrip **held,
+		BorderStrip *strip, int x, int y);
+static void frame_set_side_bg(Client *c, struct wlr_scene_rect **rect, int show,
+		int x, int y, int w, int h);
+static void renderappmenu(void);
+static void renderdirty(Monitor *m);
+static void updateuifilter(Monitor *m);
+static void ui_filter_set(struct wlr_scene_buffer *b, Monitor *m);
+static void frame_set_filter(Client *c);
+static void schedule_ui_frame(Monitor *m);
 static int appmenu_item_count(void);
-static int bartimer(void *data);
+static int bartimer(int fd, uint32_t mask, void *data);
+static void clockarm(void);
+static int clock_format(char *buf, size_t size);
+static void renderclock(Monitor *m);
 static int scrolltimer(void *data);
+static void scrollref(Monitor *m, int delta);
+static void scrolltick(Monitor *m, const struct timespec *now);
 static void togglelauncher(const Arg *arg);
 static void togglerepl(const Arg *arg);
 static void toggleappmenu(const Arg *arg);
 static void updaterepl(void);
+static void renderrepl(Monitor *m);
+static void destroyrepl(Monitor *m);
+static void repl_invalidate(void);
+static int repl_resize_history(int capacity);
 static void repl_add_line(const char *line);
 void tbwm_log(int level, const char *fmt, ...);
 static void repl_eval(void);
 static int replkey(xkb_keysym_t sym);
 static void updateframe(Client *c);
 static void updateframes(void);
+static void renderframe(Client *c);
+static void updateneighbors(Monitor *m);
+static void clientcount(Client *c, int sign);
+static void recountvisible(Monitor *m);
+static void layout_place(Monitor *m, Client *c, struct wlr_box box);
+static void layout_commit(Monitor *m);
 
 static void startdrag(struct wl_listener *listener, void *data);
 static void tag(const Arg *arg);
@@ -480,6 +696,21 @@ typedef struct {
 } CachedGlyph;
 static CachedGlyph glyph_cache[GLYPH_CACHE_SIZE];
 
+/* Fully composited cell tiles keyed by (codepoint, fg, bg). Everything we
+ * draw is a whole cell in one of a few color pairs, so a cell becomes
+ * cell_height row copies instead of a per-pixel glyph blend. */
+#define TILE_CACHE_SIZE 1024
+#define TILE_CACHE_PROBE 8
+typedef struct {
+	unsigned long charcode;
+	uint32_t fg, bg;
+	int valid;
+} CellTile;
+static CellTile tile_cache[TILE_CACHE_SIZE];
+static uint32_t *tile_pixels = NULL; /* TILE_CACHE_SIZE tiles of tile_w * tile_h */
+static int tile_w = 0, tile_h = 0;
+static unsigned long tile_hit_count = 0, tile_miss_count = 0;
+
 /* Launcher state */
 static int launcher_active = 0;
 static char launcher_input[256] = {0};
@@ -493,12 +724,16 @@ static volatile sig_atomic_t exit_requested = 0;
 static int signal_fd = -1;
 static struct wl_event_source *signal_fd_source = NULL;
 
-static struct wl_event_source *bar_timer = NULL;
+static int clock_fd = -1;                /* absolute CLOCK_REALTIME timerfd for the bar clock */
+static struct wl_event_source *clock_source = NULL;
 static uint32_t title_scroll_offset = 0; /* pixel offset for smooth title scrolling */
 static int title_scroll_mode = 1;        /* 0 = truncate with ..., 1 = scroll */
 static int title_scroll_speed = 30;      /* pixels per second */
-static struct wl_event_source *scroll_timer = NULL;
-static int any_title_needs_scroll = 0;   /* track if any title needs scrolling */
+static struct wl_event_source *scroll_timer = NULL; /* armed only while titles scroll */
+static int scrolling_titles = 0;         /* shown marquees + bars drawing overflow tabs */
+static struct timespec scroll_last;      /* time of the last scroll advance */
+static int frames_dirty = 0;             /* some client has frame_dirty set */
+static int appmenu_dirty = 0;
 static double title_scroll_accum = 0.0;  /* fractional pixel accumulator for scroll */
 
 /* REPL state */
@@ -506,23 +741,47 @@ static int repl_visible = 1;             /* 1 = REPL background/text visible */
 static int repl_input_active = 0;        /* 1 = REPL accepting keyboard input */
 static char repl_input[1024] = {0};      /* current input line */
 static int repl_input_len = 0;
-#define REPL_HISTORY_LINES 256
+#define REPL_HISTORY_LINES 256          /* default scrollback capacity */
+#define REPL_HISTORY_MAX 65536
 #define REPL_LINE_LEN 256
-static char repl_history[REPL_HISTORY_LINES][REPL_LINE_LEN];  /* scrollback buffer */
+/* Scrollback ring: repl_capacity lines of REPL_LINE_LEN bytes in one arena,
+ * the oldest line at repl_head, so appending never moves other lines */
+static char *repl_arena = NULL;
+static unsigned short *repl_line_len = NULL;
+static int repl_capacity = 0;
+static int repl_head = 0;
+static int cfg_repl_scrollback = REPL_HISTORY_LINES;
 static int repl_history_count = 0;       /* number of lines in history */
 static int repl_scroll_offset = 0;       /* scroll position (0 = bottom) */
+static unsigned long repl_line_seq = 0;  /* lines ever added; seq of the newest line */
 
 /* REPL log config: only lines with severity >= this appear in REPL */
 static int cfg_repl_log_level = TBWM_LOG_ERROR; /* default: only errors */
-/* Pipe to capture stderr and forward to REPL */
+/* Only lines with severity >= this are written to /tmp/tbwm-debug.log */
+static int cfg_file_log_level = TBWM_LOG_INFO;
+/* Buffered log ring, flushed to /tmp/tbwm-debug.log from an idle callback */
+#define LOG_RING_SIZE 65536
+static char log_ring[LOG_RING_SIZE];
+static size_t log_ring_len = 0;
+static int log_fd = -1;
+static struct wl_event_source *log_flush_source = NULL;
+/* The stderr tbwm was started with; errors are written here at once, since
+ * the ring is lost if we crash before the idle flush */
+static int log_stderr_fd = STDERR_FILENO;
+/* Pipe to capture stderr of foreign code (Xwayland, spawned programs) */
 static int repl_stderr_fd = -1; /* read end */
 static int repl_stderr_wfd = -1; /* write end */
 static struct wl_event_source *repl_stderr_source = NULL;
 
-/* Dwindle layout nodes */
-#define MAX_DWINDLE_NODES 256
-static DwindleNode dwindle_nodes[MAX_DWINDLE_NODES];
-static int dwindle_node_count = 0;
+/* Dwindle layout nodes come from slabs that are never moved or freed while
+ * running, so node pointers stay valid; free nodes are chained by parent */
+#define DWINDLE_SLAB_NODES 64
+typedef struct DwindleSlab {
+	struct DwindleSlab *next;
+	DwindleNode nodes[DWINDLE_SLAB_NODES];
+} DwindleSlab;
+static DwindleSlab *dwindle_slabs = NULL;
+static DwindleNode *dwindle_free_nodes = NULL;
 
 /* s7 Scheme interpreter */
 static s7_scheme *sc = NULL;
@@ -681,11 +940,97 @@ static int titlebuf_free_count = 0;
 static int glyph_malloc_count = 0;
 static int glyph_free_count = 0;
 static size_t glyph_total_bytes = 0;
+static unsigned long frame_redraw_count = 0;
+static unsigned long frame_skip_count = 0;
+static unsigned long bar_seg_draw_count = 0;
+static unsigned long bar_seg_skip_count = 0;
+static unsigned long damage_px_total = 0;    /* pixels damaged by buffer_commit() */
+static unsigned long damage_px_last = 0;     /* ... during the last frame that damaged any */
+static unsigned long damage_clean_count = 0; /* rewrites that changed no pixel */
+/* Strips that are rewritten in place are drawn into this scratch area
+ * first; buffer_commit() then copies only the changed spans across. */
+static uint32_t *draw_scratch_px = NULL;
+static size_t draw_scratch_cap = 0;
+static struct wl_list border_strips;     /* BorderStrip.link */
+static struct wl_list glyph_atlases;     /* GlyphAtlas.link, most recently used first */
+static int cfg_text_atlas = 0;           /* compose window titles from the glyph atlas */
+static unsigned long atlas_upload_count = 0;
+/* Bumped whenever glyph output can change without any color changing */
+static unsigned int font_serial = 0;
+
+/* Pixel storage of destroyed TitleBuffers, kept per power-of-two size class
+ * (4 KiB << class) so a resized strip doesn't go back through malloc */
+#define PIXSTORE_CLASSES 12
+#define PIXSTORE_DEPTH   4
+static void *pixstore[PIXSTORE_CLASSES][PIXSTORE_DEPTH];
+static int pixstore_n[PIXSTORE_CLASSES];
+static unsigned long pixstore_reuse_count = 0;
+
+/* Recycled TitleBuffers, most recent first; one is handed out again once
+ * nothing holds a lock on it (see titlebuf_acquire()) */
+#define TITLEBUF_POOL_MAX 16
+static struct wl_list titlebuf_pool;
+static int titlebuf_pool_len = 0;
+static unsigned long titlebuf_reuse_count = 0;
+
+static int
+pixstore_class(size_t bytes)
+{
+	int k = 0;
+
+	while (k < PIXSTORE_CLASSES && ((size_t)4096 << k) < bytes)
+		k++;
+	return k;
+}
+
+/* Storage for at least bytes, zeroed; *cap gets what was really allocated */
+static void *
+pixstore_get(size_t bytes, size_t *cap)
+{
+	int k = pixstore_class(bytes);
+	void *p;
+
+	if (k == PIXSTORE_CLASSES) {
+		*cap = bytes;
+		return ecalloc(1, bytes);
+	}
+	*cap = (size_t)4096 << k;
+	if (pixstore_n[k]) {
+		p = pixstore[k][--pixstore_n[k]];
+		memset(p, 0, bytes);
+		pixstore_reuse_count++;
+		return p;
+	}
+	return ecalloc(1, *cap);
+}
+
+static void
+pixstore_put(void *p, size_t cap)
+{
+	int k = pixstore_class(cap);
+
+	if (k < PIXSTORE_CLASSES && ((size_t)4096 << k) == cap
+			&& pixstore_n[k] < PIXSTORE_DEPTH)
+		pixstore[k][pixstore_n[k]++] = p;
+	else
+		free(p);
+}
+
+static void
+pixstore_clear(void)
+{
+	int k;
+
+	for (k = 0; k < PIXSTORE_CLASSES; k++) {
+		while (pixstore_n[k])
+			free(pixstore[k][--pixstore_n[k]]);
+	}
+}
 
 static void titlebuf_destroy(struct wlr_buffer *buf) {
 	struct TitleBuffer *tb = wl_container_of(buf, tb, base);
 	titlebuf_free_count++;
-	free(tb->data);
+	pixstore_put(tb->data, tb->cap);
 	free(tb);
 }
 
@@ -708,6 +1053,69 @@ static const struct wlr_buffer_impl titlebuf_impl = {
 	.end_data_ptr_access = titlebuf_end_data_ptr_access,
 };
 
+/* A new w x h buffer, cleared, on pooled storage where possible */
+struct TitleBuffer *
+titlebuf_create(int w, int h)
+{
+	struct TitleBuffer *tb = ecalloc(1, sizeof(*tb));
+
+	tb->stride = w * 4;
+	tb->data = pixstore_get((size_t)tb->stride * h, &tb->cap);
+	wl_list_init(&tb->link);
+	wlr_buffer_init(&tb->base, &titlebuf_impl, w, h);
+	titlebuf_alloc_count++;
+	return tb;
+}
+
+/* A w x h buffer nobody is reading, to draw a whole new image into: a
+ * recycled one whose locks have all been released, or a new one. Its old
+ * pixels are left in place. */
+struct TitleBuffer *
+titlebuf_acquire(int w, int h)
+{
+	struct TitleBuffer *tb;
+
+	wl_list_for_each(tb, &titlebuf_pool, link) {
+		if (tb->base.width == w && tb->base.height == h && !tb->base.n_locks) {
+			wl_list_remove(&tb->link);
+			wl_list_init(&tb->link);
+			titlebuf_pool_len--;
+			titlebuf_reuse_count++;
+			return tb;
+		}
+	}
+	return titlebuf_create(w, h);
+}
+
+/* Give up our reference to tb but keep it for titlebuf_acquire(); the
+ * oldest entry is dropped (its storage goes to the pixstore) when full */
+void
+titlebuf_recycle(struct TitleBuffer *tb)
+{
+	struct TitleBuffer *old;
+
+	wl_list_insert(&titlebuf_pool, &tb->link);
+	if (++titlebuf_pool_len > TITLEBUF_POOL_MAX) {
+		old = wl_container_of(titlebuf_pool.prev, old, link);
+		wl_list_remove(&old->link);
+		titlebuf_pool_len--;
+		wlr_buffer_drop(&old->base);
+	}
+}
+
+void
+titlebuf_pool_clear(void)
+{
+	struct TitleBuffer *tb, *tmp;
+
+	wl_list_for_each_safe(tb, tmp, &titlebuf_pool, link) {
+		wl_list_remove(&tb->link);
+		wlr_buffer_drop(&tb->base);
+	}
+	titlebuf_pool_len = 0;
+	pixstore_clear();
+}
+
 static pid_t child_pid = -1;
 static int locked;
 static void *exclusive_focus;
@@ -755,6 +1163,8 @@ static KeyboardGroup *kb_group;
 static unsigned int cursor_mode;
 static Client *grabc;
 static int grabcx, grabcy; /* client-relative */
+static struct wlr_box grab_box; /* latest move/resize target, see grabapply() */
+static int grab_pending;
 
 static struct wlr_output_layout *output_layout;
 static struct wlr_box sgeom;
@@ -895,12 +1305,17 @@ arrange(Monitor *m)
 
 	if (!m->wlr_output->enabled)
 		return;
+	/* The full layout below covers any pending split drag */
+	m->split_drag = NULL;
 
-	wl_list_for_each(c, &clients, link) {
-		if (c->mon == m) {
-			wlr_scene_node_set_enabled(&c->scene->node, VISIBLEON(c, m));
-			client_set_suspended(c, !VISIBLEON(c, m));
-		}
+	wl_list_for_each(c, &m->clients, mlink) {
+		wlr_scene_node_set_enabled(&c->scene->node, VISIBLEON(c, m));
+		client_set_suspended(c, !VISIBLEON(c, m));
+		/* Titles on hidden tags don't keep the animation running */
+		if (!VISIBLEON(c, m))
+			marquee_hide(&c->title_marquee);
+		else if (c->needs_title_scroll)
+			marquee_show(&c->title_marquee, m);
 	}
 
 	wlr_scene_node_set_enabled(&m->fullscreen_bg->node,
@@ -910,8 +1325,8 @@ arrange(Monitor *m)
 
 	/* We move all clients (except fullscreen and unmanaged) to LyrTile while
 	 * in floating layout to avoid "real" floating clients be always on top */
-	wl_list_for_each(c, &clients, link) {
-		if (c->mon != m || c->scene->node.parent == layers[LyrFS])
+	wl_list_for_each(c, &m->clients, mlink) {
+		if (c->scene->node.parent == layers[LyrFS])
 			continue;
 
 		wlr_scene_node_reparent(&c->scene->node,
@@ -922,12 +1337,58 @@ arrange(Monitor *m)
 								: c->scene->node.parent);
 	}
 
+	/* Geometry pass fills m->layout, then only changed boxes are applied */
+	m->layout_count = 0;
 	if (m->lt[m->sellt]->arrange)
 		m->lt[m->sellt]->arrange(m);
+	layout_commit(m);
+	updateneighbors(m);
 	motionnotify(0, NULL, 0, 0, 0, 0);
 	checkidleinhibitor(NULL);
 }
 
+/* Geometry pass: record where the layout wants c. Nothing is configured or
+ * drawn until layout_commit(), so no client sees a half-finished layout. */
+void
+layout_place(Monitor *m, Client *c, struct wlr_box box)
+{
+	if (m->layout_count == m->layout_cap) {
+		int newcap = m->layout_cap ? m->layout_cap * 2 : 16;
+		LayoutSlot *tmp = realloc(m->layout, newcap * sizeof(*tmp));
+		if (!tmp) {
+			/* Fall back to applying the box right away */
+			tbwm_log(TBWM_LOG_ERROR, "tbwm: out of memory growing layout\n");
+			resize(c, box, 0);
+			return;
+		}
+		m->layout = tmp;
+		m->layout_cap = newcap;
+	}
+	m->layout[m->layout_count].c = c;
+	m->layout[m->layout_count].box = box;
+	m->layout_count++;
+}
+
+/* Commit pass: resize (configure + frame redraw) only the clients whose box
+ * differs from what they were last given */
+void
+layout_commit(Monitor *m)
+{
+	LayoutSlot *slot;
+	int i;
+
+	for (i = 0; i < m->layout_count; i++) {
+		slot = &m->layout[i];
+		if (slot->c->req_valid && slot->c->req_font_serial == font_serial
+				&& wlr_box_equal(&slot->c->req_geom, &slot->box)) {
+			slot->c->configures_elided++;
+			continue;
+		}
+		resize(slot->c, slot->box, 0);
+	}
+	m->layout_count = 0;
+}
+
 void
 arrangelayer(Monitor *m, struct wl_list *list, struct wlr_box *usable_area, int exclusive)
 {
@@ -1179,12 +1640,8 @@ buttonpress(struct wl_listener *listener, void *data)
 			x += cell_width / 2 + cell_width * 2;
 			
 			/* Window tabs region */
-			int visible_count = 0;
+			int visible_count = selmon->nvisible;
 			Client *c;
-			wl_list_for_each(c, &clients, link) {
-				if (VISIBLEON(c, selmon))
-					visible_count++;
-			}
 			
 			if (visible_count > 0) {
 				int n = 30 * cell_width; /* reserved for date/time */
@@ -1198,7 +1655,7 @@ buttonpress(struct wl_listener *listener, void *data)
 					if (tab_width_cells < 5) tab_width_cells = 5;
 				}
 				
-				wl_list_for_each(c, &clients, link) {
+				wl_list_for_each(c, &selmon->clients, mlink) {
 					if (!VISIBLEON(c, selmon))
 						continue;
 					
@@ -1297,6 +1754,8 @@ buttonpress(struct wl_listener *listener, void *data)
 		if (!locked && cursor_mode != CurNormal && cursor_mode != CurPressed) {
 			wlr_cursor_set_xcursor(cursor, cursor_mgr, "default");
 			cursor_mode = CurNormal;
+			/* The last motion may not have had its frame yet */
+			grabapply();
 			/* Snap position to grid on drop */
 			if (grabc && cell_width > 0 && cell_height > 0) {
 				struct wlr_box snapped = grabc->geom;
@@ -1378,13 +1837,20 @@ cleanup(void)
 		}
 	}
 
-	/* Clean up all monitor bar buffers */
+	/* Clean up all monitor bars */
 	Monitor *m;
-	wl_list_for_each(m, &mons, link) {
-		if (m->bar) {
-			wlr_scene_buffer_set_buffer(m->bar, NULL);
-		}
-	}
+	wl_list_for_each(m, &mons, link)
+		destroybar(m);
+	glyph_atlas_clear();
+	while (dwindle_slabs) {
+		DwindleSlab *slab = dwindle_slabs;
+		dwindle_slabs = slab->next;
+		free(slab);
+	}
+	dwindle_free_nodes = NULL;
+	free(draw_scratch_px);
+	draw_scratch_px = NULL;
+	draw_scratch_cap = 0;
 
 	/* Clean up app menu buffer */
 	if (appmenu_buffer) {
@@ -1397,9 +1863,7 @@ cleanup(void)
 
 	/* Clean up REPL buffers on all monitors */
 	wl_list_for_each(m, &mons, link) {
-		if (m->repl) {
-			wlr_scene_buffer_set_buffer(m->repl, NULL);
-		}
+		destroyrepl(m);
 	}
 
 	/* Clean up FreeType */
@@ -1425,6 +1889,14 @@ cleanup(void)
 		close(signal_fd);
 		signal_fd = -1;
 	}
+	if (clock_source) {
+		wl_event_source_remove(clock_source);
+		clock_source = NULL;
+	}
+	if (clock_fd >= 0) {
+		close(clock_fd);
+		clock_fd = -1;
+	}
 
 	/* Remove REPL stderr capture */
 	if (repl_stderr_source) {
@@ -1457,9 +1929,32 @@ cleanup(void)
 	wlr_backend_destroy(backend);
 
 	wl_display_destroy(dpy);
+	/* The idle flush went away with the event loop */
+	event_loop = NULL;
+	log_flush_source = NULL;
 	/* Destroy after the wayland display (when the monitors are already destroyed)
 	   to avoid destroying them with an invalid scene output. */
 	wlr_scene_node_destroy(&scene->tree.node);
+	/* Every TitleBuffer owner (menu, REPL, bars, frames, scene nodes) is
+	 * gone, so nothing sends storage back to the pixstore after this */
+	titlebuf_pool_clear();
+
+	log_flush();
+	if (log_fd >= 0) {
+		close(log_fd);
+		log_fd = -1;
+	}
+	if (log_stderr_fd > STDERR_FILENO) {
+		close(log_stderr_fd);
+		log_stderr_fd = STDERR_FILENO;
+	}
+
+	/* REPL scrollback; last, since logging appends to it */
+	free(repl_arena);
+	free(repl_line_len);
+	repl_arena = NULL;
+	repl_line_len = NULL;
+	repl_capacity = repl_head = repl_history_count = 0;
 }
 
 void
@@ -1469,10 +1964,8 @@ cleanupmon(struct wl_listener *listener, void *data)
 	LayerSurface *l, *tmp;
 	size_t i;
 
-	/* Clean up bar buffer */
-	if (m->bar) {
-		wlr_scene_buffer_set_buffer(m->bar, NULL);
-	}
+	destroybar(m);
+	destroyrepl(m);
 
 	/* m->layers[i] are intentionally not unlinked */
 	for (i = 0; i < LENGTH(m->layers); i++) {
@@ -1492,6 +1985,9 @@ cleanupmon(struct wl_listener *listener, void *data)
 
 	closemon(m);
 	wlr_scene_node_destroy(&m->fullscreen_bg->node);
+	free(m->layout);
+	free(m->tiled.by_x);
+	free(m->tiled.by_y);
 	free(m);
 }
 
@@ -1541,13 +2037,8 @@ closemon(Monitor *m)
 	int i = 0, nmons = wl_list_length(&mons);
 	tbwm_log(TBWM_LOG_WARN, "closemon: closing monitor %s", m->wlr_output->name);
 
-	/* Release cached bar buffer */
-	if (m->bar_buf) {
-		if (m->bar)
-			wlr_scene_buffer_set_buffer(m->bar, NULL);
-		wlr_buffer_drop(&m->bar_buf->base);
-		m->bar_buf = NULL;
-	}
+	/* Release the bar and its cached segments */
+	destroybar(m);
 
 	if (!nmons) {
 		selmon = NULL;
@@ -1561,6 +2052,9 @@ closemon(Monitor *m)
 	}
 
 	wl_list_for_each(c, &clients, link) {
+		/* Don't leave a count on the output going away */
+		if (c->title_marquee.shown && c->title_marquee.mon == m)
+			marquee_hide(&c->title_marquee);
 		if (c->mon == m) {
 			/* Save the monitor name so we can restore when it comes back
 			 * Only save if not already set (preserve original monitor) */
@@ -1815,6 +2309,7 @@ createmon(struct wl_listener *listener, void *data)
 
 	for (i = 0; i < LENGTH(m->layers); i++)
 		wl_list_init(&m->layers[i]);
+	wl_list_init(&m->clients);
 
 	wlr_output_state_init(&state);
 	/* Initialize monitor state using configured rules */
@@ -2178,48 +2673,59 @@ dirtomon(enum wlr_direction dir)
 	return selmon;
 }
 
-/* Allocate a new dwindle node */
+/* Allocate a new dwindle node, adding a slab when the free list is empty */
 static DwindleNode *
 dwindle_alloc(void)
 {
+	DwindleSlab *slab;
 	DwindleNode *n;
-	if (dwindle_node_count >= MAX_DWINDLE_NODES) {
-		tbwm_log(TBWM_LOG_ERROR, "dwindle: out of nodes\n");
-		return NULL;
+	int i;
+
+	if (!dwindle_free_nodes) {
+		slab = ecalloc(1, sizeof(*slab));
+		slab->next = dwindle_slabs;
+		dwindle_slabs = slab;
+		for (i = DWINDLE_SLAB_NODES - 1; i >= 0; i--) {
+			slab->nodes[i].parent = dwindle_free_nodes;
+			dwindle_free_nodes = &slab->nodes[i];
+		}
 	}
-	n = &dwindle_nodes[dwindle_node_count++];
+	n = dwindle_free_nodes;
+	dwindle_free_nodes = n->parent;
 	memset(n, 0, sizeof(*n));
 	return n;
 }
 
-/* Free a dwindle node (swap with last, decrement count) */
+/* Return a dwindle node to the free list; no other node moves */
 static void
 dwindle_free(DwindleNode *node)
 {
-	int idx;
-	DwindleNode *last;
-	
+	Monitor *m;
+
 	if (!node) return;
-	idx = node - dwindle_nodes;
-	if (idx < 0 || idx >= dwindle_node_count) return;
-	
-	/* If not the last node, swap with last */
-	if (idx < dwindle_node_count - 1) {
-		last = &dwindle_nodes[dwindle_node_count - 1];
-		/* Update references to the last node */
-		if (last->parent) {
-			if (last->parent->children[0] == last)
-				last->parent->children[0] = node;
-			else if (last->parent->children[1] == last)
-				last->parent->children[1] = node;
-		}
-		if (last->children[0]) last->children[0]->parent = node;
-		if (last->children[1]) last->children[1]->parent = node;
-		if (last->client) last->client->dwindle = node;
-		
-		*node = *last;
+	wl_list_for_each(m, &mons, link) {
+		if (m->split_drag == node)
+			m->split_drag = NULL;
+	}
+	memset(node, 0, sizeof(*node));
+	node->parent = dwindle_free_nodes;
+	dwindle_free_nodes = node;
+}
+
+/* Point the tag slots of m that hold old at new. old NULL files a new root
+ * under its tags that have no tree yet; new NULL drops a tree. */
+static void
+dwindle_reroot(Monitor *m, DwindleNode *old, DwindleNode *new)
+{
+	int i;
+
+	if (!m)
+		return;
+	for (i = 0; i < (int)LENGTH(m->dwindle_roots); i++) {
+		if (old ? m->dwindle_roots[i] == old
+				: (!m->dwindle_roots[i] && (new->tags & 1u << i)))
+			m->dwindle_roots[i] = new;
 	}
-	dwindle_node_count--;
 }
 
 /* Find the root node for a monitor/tags combination */
@@ -2227,12 +2733,10 @@ DwindleNode *
 dwindle_find_root(Monitor *m, uint32_t tags)
 {
 	int i;
-	DwindleNode *n;
-	
-	for (i = 0; i < dwindle_node_count; i++) {
-		n = &dwindle_nodes[i];
-		if (n->mon == m && (n->tags & tags) && n->parent == NULL)
-			return n;
+
+	for (i = 0; i < (int)LENGTH(m->dwindle_roots); i++) {
+		if ((tags & 1u << i) && m->dwindle_roots[i])
+			return m->dwindle_roots[i];
 	}
 	return NULL;
 }
@@ -2248,9 +2752,9 @@ dwindle_recalc(DwindleNode *node)
 	if (!node) return;
 	
 	if (node->client) {
-		/* Leaf node: apply geometry to client (skip fullscreen clients) */
-		if (!node->client->isfullscreen)
-			resize(node->client, node->box, 0);
+		/* Leaf node: queue geometry for the client (skip fullscreen clients) */
+		if (!node->client->isfullscreen && node->client->mon)
+			layout_place(node->client->mon, node->client, node->box);
 	} else {
 		/* Internal node: split and recurse */
 		c0 = node->children[0];
@@ -2300,16 +2804,26 @@ dwindle_recalc(DwindleNode *node)
 			c1->box.height = node->box.height - split_size + cell_height;
 		}
 		
-		c0->mon = node->mon;
-		c0->tags = node->tags;
-		c1->mon = node->mon;
-		c1->tags = node->tags;
-		
 		dwindle_recalc(c0);
 		dwindle_recalc(c1);
 	}
 }
 
+/* Lay out the subtree under the split a drag moved since the last frame.
+ * Its box hasn't changed, so nothing outside it can move; layout_commit()
+ * then only configures windows whose snapped box did. */
+void
+dwindle_drag(Monitor *m)
+{
+	DwindleNode *node = m->split_drag;
+
+	m->split_drag = NULL;
+	m->layout_count = 0;
+	dwindle_recalc(node);
+	layout_commit(m);
+	updateneighbors(m);
+}
+
 /* Create a dwindle node for a new client, splitting the focused window */
 DwindleNode *
 dwindle_create(Client *c)
@@ -2334,6 +2848,7 @@ dwindle_create(Client *c)
 		/* First window on this tag: becomes root, gets full area */
 		node->box = c->mon->w;
 		node->parent = NULL;
+		dwindle_reroot(c->mon, NULL, node);
 		return node;
 	}
 	
@@ -2375,6 +2890,9 @@ dwindle_create(Client *c)
 	new_parent->mon = target->mon;
 	new_parent->tags = target->tags;
 	new_parent->parent = target->parent;
+	/* The new window joins target's tree */
+	node->mon = target->mon;
+	node->tags = target->tags;
 	
 	/* Decide split direction: horizontal if wider, vertical if taller */
 	new_parent->split_horizontal = (target->box.width >= target->box.height);
@@ -2385,6 +2903,8 @@ dwindle_create(Client *c)
 			target->parent->children[0] = new_parent;
 		else
 			target->parent->children[1] = new_parent;
+	} else {
+		dwindle_reroot(target->mon, target, new_parent);
 	}
 	
 	/* Set up children: existing window first, new window second */
@@ -2411,6 +2931,7 @@ dwindle_remove(Client *c)
 	
 	if (!parent) {
 		/* This was the root - just free it */
+		dwindle_reroot(node->mon, node, NULL);
 		dwindle_free(node);
 		return;
 	}
@@ -2426,6 +2947,8 @@ dwindle_remove(Client *c)
 				parent->parent->children[0] = NULL;
 			else
 				parent->parent->children[1] = NULL;
+		} else {
+			dwindle_reroot(parent->mon, parent, NULL);
 		}
 		dwindle_free(parent);
 		dwindle_free(node);
@@ -2441,6 +2964,8 @@ dwindle_remove(Client *c)
 			parent->parent->children[0] = sibling;
 		else
 			parent->parent->children[1] = sibling;
+	} else {
+		dwindle_reroot(parent->mon, parent, sibling);
 	}
 	
 	dwindle_free(parent);
@@ -2452,107 +2977,203 @@ void
 dwindle_arrange(Monitor *m, uint32_t tags)
 {
 	DwindleNode *root;
-	int i;
-	DwindleNode *n;
 
-	/* First, update all dwindle nodes to match their client's current monitor/tags */
-	for (i = 0; i < dwindle_node_count; i++) {
-		n = &dwindle_nodes[i];
-		if (n->client) {
-			n->mon = n->client->mon;
-			n->tags = n->client->tags;
-		}
+	/* Trees only change owner when a client moves (setmon(), tag(),
+	 * toggletag()), which takes it out of its tree first */
+	root = dwindle_find_root(m, tags);
+	if (root) {
+		root->box = m->w;
+		dwindle_recalc(root);
 	}
+}
 
-	/* Propagate monitor/tags up the tree for internal nodes */
-	for (i = 0; i < dwindle_node_count; i++) {
-		n = &dwindle_nodes[i];
-		if (!n->client && n->children[0]) {
-			n->mon = n->children[0]->mon;
-			n->tags = n->children[0]->tags;
+/* Best window in a direction so far, see dir_consider() */
+typedef struct {
+	Client *best;
+	int ratio, pos, dist;
+} DirPick;
+
+/* Offer `other` as the window in direction dir from c. It has to lie on
+ * that side of c's center and overlap it across the direction; the one
+ * covering the largest share of its own extent wins, then the topmost or
+ * leftmost, then the nearest. */
+static void
+dir_consider(DirPick *p, const Client *c, Client *other, int dir)
+{
+	const struct wlr_box *a = &c->geom, *b = &other->geom;
+	int overlap = 0, pos = 0, dist = 0, size = 1, ratio;
+
+	switch (dir) {
+	case DirLeft:
+		if (b->x + b->width <= a->x + a->width/2 && b->x < a->x) {
+			overlap = MIN(a->y + a->height, b->y + b->height) - MAX(a->y, b->y);
+			pos = b->y;
+			size = b->height;
+			dist = a->x - (b->x + b->width);
+		}
+		break;
+	case DirRight:
+		if (b->x >= a->x + a->width/2 && b->x + b->width > a->x + a->width) {
+			overlap = MIN(a->y + a->height, b->y + b->height) - MAX(a->y, b->y);
+			pos = b->y;
+			size = b->height;
+			dist = b->x - (a->x + a->width);
+		}
+		break;
+	case DirUp:
+		if (b->y + b->height <= a->y + a->height/2 && b->y < a->y) {
+			overlap = MIN(a->x + a->width, b->x + b->width) - MAX(a->x, b->x);
+			pos = b->x;
+			size = b->width;
+			dist = a->y - (b->y + b->height);
 		}
+		break;
+	case DirDown:
+		if (b->y >= a->y + a->height/2 && b->y + b->height > a->y + a->height) {
+			overlap = MIN(a->x + a->width, b->x + b->width) - MAX(a->x, b->x);
+			pos = b->x;
+			size = b->width;
+			dist = b->y - (a->y + a->height);
+		}
+		break;
 	}
 
-	root = dwindle_find_root(m, tags);
-	if (root) {
-		root->box = m->w;
-		dwindle_recalc(root);
+	if (overlap <= 0 || other == c)
+		return;
+	ratio = (overlap * 100) / size;
+	if (!p->best || ratio > p->ratio || (ratio == p->ratio && (pos < p->pos
+			|| (pos == p->pos && dist < p->dist)))) {
+		p->best = other;
+		p->ratio = ratio;
+		p->pos = pos;
+		p->dist = dist;
+	}
+}
+
+int
+tileindex_reserve(TileIndex *ix, int n)
+{
+	int newcap;
+	Client **bx, **by;
+
+	if (n <= ix->cap)
+		return 1;
+	newcap = ix->cap ? ix->cap * 2 : 32;
+	while (newcap < n)
+		newcap *= 2;
+	bx = realloc(ix->by_x, newcap * sizeof(*bx));
+	if (bx)
+		ix->by_x = bx;
+	by = realloc(ix->by_y, newcap * sizeof(*by));
+	if (by)
+		ix->by_y = by;
+	if (!bx || !by)
+		return 0;
+	ix->cap = newcap;
+	return 1;
+}
+
+static int
+tileindex_cmp_x(const void *a, const void *b)
+{
+	const Client *ca = *(Client *const *)a, *cb = *(Client *const *)b;
+	return (ca->geom.x > cb->geom.x) - (ca->geom.x < cb->geom.x);
+}
+
+static int
+tileindex_cmp_y(const void *a, const void *b)
+{
+	const Client *ca = *(Client *const *)a, *cb = *(Client *const *)b;
+	return (ca->geom.y > cb->geom.y) - (ca->geom.y < cb->geom.y);
+}
+
+/* Sort the ix->n windows filled into by_x along both axes */
+void
+tileindex_sort(TileIndex *ix)
+{
+	memcpy(ix->by_y, ix->by_x, ix->n * sizeof(*ix->by_y));
+	qsort(ix->by_x, ix->n, sizeof(*ix->by_x), tileindex_cmp_x);
+	qsort(ix->by_y, ix->n, sizeof(*ix->by_y), tileindex_cmp_y);
+}
+
+/* Drop c before it leaves the monitor, in case no layout pass follows
+ * (arrange() skips disabled outputs) */
+void
+tileindex_remove(TileIndex *ix, Client *c)
+{
+	int i, j, k;
+
+	for (i = j = k = 0; i < ix->n; i++) {
+		if (ix->by_x[i] != c)
+			ix->by_x[j++] = ix->by_x[i];
+		if (ix->by_y[i] != c)
+			ix->by_y[k++] = ix->by_y[i];
+	}
+	ix->n = j;
+}
+
+/* First of v[0..n) whose left (or top) edge is at least key */
+static int
+tileindex_lower(Client *const *v, int n, int vertical, int key)
+{
+	int lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if ((vertical ? v[mid]->geom.y : v[mid]->geom.x) < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Window in direction dir from c among ix. A candidate has to lie on
+ * that side of c (a range of the list sorted along dir) and overlap c
+ * across it (a prefix of the other list); two binary searches bound both
+ * and only the shorter range is scored. */
+Client *
+tileindex_dir(const TileIndex *ix, const Client *c, int dir)
+{
+	const struct wlr_box *a = &c->geom;
+	Client *const *along, *const *across;
+	int lo, hi, cross, vertical = (dir == DirUp || dir == DirDown);
+	DirPick p = {0};
+
+	along = vertical ? ix->by_y : ix->by_x;
+	across = vertical ? ix->by_x : ix->by_y;
+	switch (dir) {
+	case DirLeft:
+	case DirUp:
+		lo = 0;
+		hi = tileindex_lower(along, ix->n, vertical, vertical ? a->y : a->x);
+		break;
+	default:
+		lo = tileindex_lower(along, ix->n, vertical,
+				vertical ? a->y + a->height/2 : a->x + a->width/2);
+		hi = ix->n;
+		break;
 	}
+	cross = tileindex_lower(across, ix->n, !vertical,
+			vertical ? a->x + a->width : a->y + a->height);
+
+	if (hi - lo <= cross) {
+		for (; lo < hi; lo++)
+			dir_consider(&p, c, along[lo], dir);
+	} else {
+		for (lo = 0; lo < cross; lo++)
+			dir_consider(&p, c, across[lo], dir);
+	}
+	return p.best;
 }
 
 /* Find client in the given direction from c */
 Client *
 client_in_direction(Client *c, int dir)
 {
-	Client *best = NULL, *other;
-	int best_ratio = 0;
-	int best_pos = INT_MAX;
-	int overlap, pos, ratio, candidate_size;
-	int ax, ay, aw, ah;
-	int bx, by, bw, bh;
-	
-	if (!c || !c->mon) return NULL;
-	
-	ax = c->geom.x;
-	ay = c->geom.y;
-	aw = c->geom.width;
-	ah = c->geom.height;
-	
-	wl_list_for_each(other, &clients, link) {
-		if (other == c || !VISIBLEON(other, c->mon) || other->isfloating || other->isfullscreen)
-			continue;
-		
-		bx = other->geom.x;
-		by = other->geom.y;
-		bw = other->geom.width;
-		bh = other->geom.height;
-		
-		overlap = 0;
-		pos = 0;
-		candidate_size = 1;
-		
-		switch (dir) {
-		case DirLeft:
-			if (bx + bw <= ax + aw/2 && bx < ax) {
-				overlap = MIN(ay + ah, by + bh) - MAX(ay, by);
-				pos = by;
-				candidate_size = bh;
-			}
-			break;
-		case DirRight:
-			if (bx >= ax + aw/2 && bx + bw > ax + aw) {
-				overlap = MIN(ay + ah, by + bh) - MAX(ay, by);
-				pos = by;
-				candidate_size = bh;
-			}
-			break;
-		case DirUp:
-			if (by + bh <= ay + ah/2 && by < ay) {
-				overlap = MIN(ax + aw, bx + bw) - MAX(ax, bx);
-				pos = bx;
-				candidate_size = bw;
-			}
-			break;
-		case DirDown:
-			if (by >= ay + ah/2 && by + bh > ay + ah) {
-				overlap = MIN(ax + aw, bx + bw) - MAX(ax, bx);
-				pos = bx;
-				candidate_size = bw;
-			}
-			break;
-		}
-		
-		if (overlap > 0) {
-			ratio = (overlap * 100) / candidate_size;
-			if (!best || ratio > best_ratio || (ratio == best_ratio && pos < best_pos)) {
-				best_ratio = ratio;
-				best_pos = pos;
-				best = other;
-			}
-		}
-	}
-	
-	return best;
+	if (!c || !c->mon)
+		return NULL;
+	return tileindex_dir(&c->mon->tiled, c, dir);
 }
 
 /* Focus window in direction */
@@ -2632,8 +3253,8 @@ swapdir(const Arg *arg)
 			return;
 		}
 		node->client = sel;
-		node->mon = sel->mon;
-		node->tags = sel->tags;
+		node->mon = sibling->mon;
+		node->tags = sibling->tags;
 		sel->dwindle = node;
 		
 		/* Create new parent with the new split direction */
@@ -2656,6 +3277,8 @@ swapdir(const Arg *arg)
 				sibling->parent->children[0] = new_parent;
 			else
 				sibling->parent->children[1] = new_parent;
+		} else {
+			dwindle_reroot(sibling->mon, sibling, new_parent);
 		}
 		
 		/* Order: sel goes in the direction we moved */
@@ -2675,10 +3298,9 @@ swapdir(const Arg *arg)
 		return;
 	}
 	
-	/* Remove sel from tree - target->dwindle may move due to dwindle_free swap */
+	/* Remove sel from tree */
 	dwindle_remove(sel);
 	
-	/* Re-fetch target_node after removal (it may have moved in array) */
 	target_node = target->dwindle;
 	if (!target_node) {
 		arrange(selmon);
@@ -2693,8 +3315,8 @@ swapdir(const Arg *arg)
 	}
 	
 	node->client = sel;
-	node->mon = sel->mon;
-	node->tags = sel->tags;
+	node->mon = target_node->mon;
+	node->tags = target_node->tags;
 	sel->dwindle = node;
 	
 	/* Create new parent to hold both target and sel */
@@ -2723,6 +3345,8 @@ swapdir(const Arg *arg)
 			target_node->parent->children[0] = new_parent;
 		else
 			target_node->parent->children[1] = new_parent;
+	} else {
+		dwindle_reroot(target_node->mon, target_node, new_parent);
 	}
 	
 	/* Order children based on direction: sel goes in direction we moved FROM */
@@ -2757,7 +3381,7 @@ focusclient(Client *c, int lift)
 	if (c && lift) {
 		wlr_scene_node_raise_to_top(&c->scene->node);
 		/* Ensure floating windows stay above tiled windows */
-		if (!c->isfloating) {
+		if (!c->isfloating && c->mon && c->mon->nvisible_floating) {
 			Client *f;
 			wl_list_for_each(f, &fstack, flink) {
 				if (f->isfloating && VISIBLEON(f, c->mon))
@@ -2848,15 +3472,15 @@ focusstack(const Arg *arg)
 	if (!sel || (sel->isfullscreen && !client_has_children(sel)))
 		return;
 	if (arg->i > 0) {
-		wl_list_for_each(c, &sel->link, link) {
-			if (&c->link == &clients)
+		wl_list_for_each(c, &sel->mlink, mlink) {
+			if (&c->mlink == &selmon->clients)
 				continue; /* wrap past the sentinel node */
 			if (VISIBLEON(c, selmon))
 				break; /* found it */
 		}
 	} else {
-		wl_list_for_each_reverse(c, &sel->link, link) {
-			if (&c->link == &clients)
+		wl_list_for_each_reverse(c, &sel->mlink, mlink) {
+			if (&c->mlink == &selmon->clients)
 				continue; /* wrap past the sentinel node */
 			if (VISIBLEON(c, selmon))
 				break; /* found it */
@@ -2908,6 +3532,10 @@ gpureset(struct wl_listener *listener, void *data)
 		wlr_output_init_render(m->wlr_output, alloc, drw);
 	}
 
+	/* Atlas textures belong to the old renderer */
+	glyph_atlas_clear();
+	updateframes();
+
 	wlr_allocator_destroy(old_alloc);
 	wlr_renderer_destroy(old_drw);
 }
@@ -2949,8 +3577,27 @@ signal_fd_cb(int fd, uint32_t mask, void *data)
 	return 1; /* continue watching */
 }
 
-/* Callback that reads captured stderr and forwards WARNING/ERROR lines to the REPL.
- * We avoid calling tbwm_log() here to prevent a feedback loop into the pipe. */
+/* Guess the severity of a line of foreign stderr output, which has no
+ * structure we can rely on. */
+static int
+stderr_severity(const char *line)
+{
+	const char *p;
+	int sev = TBWM_LOG_INFO;
+
+	for (p = line; *p; p++) {
+		if (!strncasecmp(p, "error", 5) || !strncasecmp(p, "err:", 4)
+				|| !strncasecmp(p, "failed", 6))
+			return TBWM_LOG_ERROR;
+		if (!strncasecmp(p, "warn", 4))
+			sev = TBWM_LOG_WARN;
+	}
+	return sev;
+}
+
+/* Callback that reads captured stderr of foreign code and logs it.
+ * Our own messages never go through here; tbwm_log() feeds the log
+ * ring and the REPL directly. */
 static int
 repl_stderr_cb(int fd, uint32_t mask, void *data)
 {
@@ -2977,11 +3624,7 @@ repl_stderr_cb(int fd, uint32_t mask, void *data)
 		if (partial_len + (size_t)r >= sizeof(partial) - 1) {
 			/* overflow - flush what we have */
 			partial[partial_len] = '\0';
-			/* write to debug file */
-			file_debug_log("%s\n", partial);
-			/* if it looks like a WARN/ERROR, send to REPL */
-			if (strstr(partial, "ERROR") || strstr(partial, "error") || strstr(partial, "err:") || strstr(partial, "failed") || strstr(partial, "WARN") || strstr(partial, "warn"))
-				repl_add_line(partial);
+			log_line(stderr_severity(partial), partial, partial_len);
 			partial_len = 0;
 		}
 
@@ -2991,22 +3634,14 @@ repl_stderr_cb(int fd, uint32_t mask, void *data)
 
 		/* Process full lines */
 		char *line_start = partial;
-		char *nl;
+		char *nl, *end;
 		while ((nl = strchr(line_start, '\n')) != NULL) {
 			*nl = '\0';
 			/* Trim trailing carriage return */
-			if (nl > line_start && nl[-1] == '\r')
-				nl[-1] = '\0';
-			/* Write to debug file */
-			file_debug_log("%s\n", line_start);
-			/* Detect severity and forward to REPL if level >= cfg_repl_log_level */
-			int sev = TBWM_LOG_INFO;
-			if (strstr(line_start, "ERROR") || strstr(line_start, "error") || strstr(line_start, "err:") || strstr(line_start, "failed"))
-				sev = TBWM_LOG_ERROR;
-			else if (strstr(line_start, "WARN") || strstr(line_start, "warn"))
-				sev = TBWM_LOG_WARN;
-			if (sev >= cfg_repl_log_level)
-				repl_add_line(line_start);
+			end = nl;
+			if (end > line_start && end[-1] == '\r')
+				*--end = '\0';
+			log_line(stderr_severity(line_start), line_start, end - line_start);
 
 			/* Move to next line */
 			line_start = nl + 1;
@@ -3427,7 +4062,7 @@ keybinding(uint32_t mods, xkb_keysym_t sym)
 	for (k = keys; k < END(keys); k++) {
 		if (CLEANMASK(mods) == CLEANMASK(k->mod)
 				&& sym == k->keysym && k->func) {
-			tbwm_log(TBWM_LOG_INFO, "tbwm: keybinding matched mods=0x%x sym=0x%x func=%p\n", mods, sym, (void*)k->func);
+			tbwm_log(TBWM_LOG_DEBUG, "tbwm: keybinding matched mods=0x%x sym=0x%x func=%p\n", mods, sym, (void*)k->func);
 			k->func(&k->arg);
 			return 1;
 		}
@@ -3581,6 +4216,9 @@ mapnotify(struct wl_listener *listener, void *data)
 	c->frame_bottom = NULL;
 	c->frame_left = NULL;
 	c->frame_right = NULL;
+	c->frame_state_valid = 0;
+	c->req_valid = 0;
+	c->sized_valid = 0;
 	c->dwindle = NULL;
 
 	/* Initialize client geometry with room for text frame (1 cell each side) */
@@ -3636,10 +4274,10 @@ monocle(Monitor *m)
 	Client *c;
 	int n = 0;
 
-	wl_list_for_each(c, &clients, link) {
+	wl_list_for_each(c, &m->clients, mlink) {
 		if (!VISIBLEON(c, m) || c->isfloating || c->isfullscreen)
 			continue;
-		resize(c, m->w, 0);
+		layout_place(m, c, m->w);
 		n++;
 	}
 	if (n)
@@ -3668,9 +4306,33 @@ motionabsolute(struct wl_listener *listener, void *data)
 	motionnotify(event->time_msec, &event->pointer->base, dx, dy, dx, dy);
 }
 
+/* Apply the move/resize target queued by grabqueue() */
 void
-motionnotify(uint32_t time, struct wlr_input_device *device, double dx, double dy,
-		double dx_unaccel, double dy_unaccel)
+grabapply(void)
+{
+	if (!grab_pending)
+		return;
+	grab_pending = 0;
+	if (grabc)
+		resize(grabc, grab_box, 1);
+}
+
+/* Remember box as the grabbed window's target; it is applied once per frame
+ * of the window's output, however many pointer events come in before it */
+void
+grabqueue(struct wlr_box box)
+{
+	grab_box = box;
+	grab_pending = 1;
+	if (grabc->mon && grabc->mon->wlr_output->enabled)
+		schedule_ui_frame(grabc->mon);
+	else
+		grabapply();
+}
+
+void
+motionnotify(uint32_t time, struct wlr_input_device *device, double dx, double dy,
+		double dx_unaccel, double dy_unaccel)
 {
 	double sx = 0, sy = 0, sx_confined, sy_confined;
 	Client *c = NULL, *w = NULL;
@@ -3756,18 +4418,17 @@ motionnotify(uint32_t time, struct wlr_input_device *device, double dx, double d
 		int new_y = (int)round(cursor->y) - grabcy;
 		new_x = (new_x / cell_width) * cell_width;
 		new_y = (new_y / cell_height) * cell_height;
-		resize(grabc, (struct wlr_box){.x = new_x, .y = new_y,
-			.width = grabc->geom.width, .height = grabc->geom.height}, 1);
+		grabqueue((struct wlr_box){.x = new_x, .y = new_y,
+			.width = grabc->geom.width, .height = grabc->geom.height});
 		return;
 	} else if (cursor_mode == CurResize) {
 		if (grabc->isfloating) {
 			/* Floating: direct resize */
-			resize(grabc, (struct wlr_box){.x = grabc->geom.x, .y = grabc->geom.y,
-				.width = (int)round(cursor->x) - grabc->geom.x, .height = (int)round(cursor->y) - grabc->geom.y}, 1);
+			grabqueue((struct wlr_box){.x = grabc->geom.x, .y = grabc->geom.y,
+				.width = (int)round(cursor->x) - grabc->geom.x, .height = (int)round(cursor->y) - grabc->geom.y});
 		} else if (grabc->dwindle && grabc->dwindle->parent) {
 			/* Tiled: adjust split ratio of parent node */
 			DwindleNode *parent = grabc->dwindle->parent;
-			DwindleNode *root;
 			int is_first_child = (parent->children[0] == grabc->dwindle);
 			float new_ratio;
 			
@@ -3790,12 +4451,23 @@ motionnotify(uint32_t time, struct wlr_input_device *device, double dx, double d
 			if (new_ratio < 0.1f) new_ratio = 0.1f;
 			if (new_ratio > 0.9f) new_ratio = 0.9f;
 			
+			if (new_ratio == parent->split_ratio)
+				return;
 			parent->split_ratio = new_ratio;
 			
-			/* Find root and recalculate entire tree */
-			root = parent;
-			while (root->parent) root = root->parent;
-			dwindle_recalc(root);
+			/* Laid out once per output frame, from this split down */
+			if (grabc->mon->split_drag && grabc->mon->split_drag != parent) {
+				/* Two splits moved: redo from the one that holds both */
+				DwindleNode *a, *b;
+				for (a = parent; a; a = a->parent) {
+					for (b = grabc->mon->split_drag; b && b != a; b = b->parent);
+					if (b)
+						break;
+				}
+				parent = a ? a : parent;
+			}
+			grabc->mon->split_drag = parent;
+			schedule_ui_frame(grabc->mon);
 		}
 		return;
 	}
@@ -3978,13 +4650,14 @@ printstatus(void)
 	Monitor *m = NULL;
 	Client *c;
 	uint32_t occ, urg, sel;
+	size_t i;
 
 	wl_list_for_each(m, &mons, link) {
 		occ = urg = 0;
-		wl_list_for_each(c, &clients, link) {
-			if (c->mon != m)
-				continue;
-			occ |= c->tags;
+		for (i = 0; i < LENGTH(m->tag_clients); i++)
+			if (m->tag_clients[i])
+				occ |= 1u << i;
+		wl_list_for_each(c, &m->clients, mlink) {
 			if (c->isurgent)
 				urg |= c->tags;
 		}
@@ -4061,9 +4734,26 @@ rendermon(struct wl_listener *listener, void *data)
 	Client *c;
 	struct wlr_output_state pending = {0};
 	struct timespec now;
+	unsigned long damaged = damage_px_total;
 
 	clock_gettime(CLOCK_MONOTONIC, &now);
 
+	/* Advance scrolling titles before drawing so overflow tabs are current */
+	if (scrolling_titles)
+		scrolltick(m, &now);
+
+	/* Apply split drags and window moves/resizes since the last frame
+	 * before frames are drawn */
+	if (m->split_drag)
+		dwindle_drag(m);
+	if (grab_pending && grabc && grabc->mon == m)
+		grabapply();
+
+	/* UI updates requested since the last frame are drawn once, here */
+	renderdirty(m);
+	if (damage_px_total != damaged)
+		damage_px_last = damage_px_total - damaged;
+
 	/* Render if no XDG clients have an outstanding resize and are visible on
 	 * this monitor. */
 	wl_list_for_each(c, &clients, link) {
@@ -4118,6 +4808,10 @@ resize(Client *c, struct wlr_box geo, int interact)
 	if (!c->mon || !client_surface(c)->mapped)
 		return;
 
+	c->req_geom = geo;
+	c->req_font_serial = font_serial;
+	c->req_valid = 1;
+
 	bbox = interact ? &sgeom : (c->isfullscreen ? &c->mon->m : &c->mon->w);
 
 	/* Snap to grid if not fullscreen */
@@ -4136,10 +4830,28 @@ resize(Client *c, struct wlr_box geo, int interact)
 		if (geo.height < cell_height * 3) geo.height = cell_height * 3;
 	}
 
-	client_set_bounds(c, geo.width, geo.height);
 	c->geom = geo;
 	applybounds(c, bbox);
 
+	/* Same box, fullscreen state and cell size as the configure the client
+	 * already acked: only the clip can be stale (the client may have moved
+	 * its xdg geometry). This is the common case for commitnotify(). Compare
+	 * against the box last applied, not c->geom on entry: callers may have
+	 * written c->geom before passing it in (moveresize()). */
+	if (c->sized_valid && !c->resize && wlr_box_equal(&c->geom, &c->sized_geom)
+			&& c->sized_fullscreen == c->isfullscreen
+			&& c->sized_font_serial == font_serial) {
+		client_get_clip(c, &clip);
+		if (!wlr_box_equal(&clip, &c->sized_clip)) {
+			c->sized_clip = clip;
+			wlr_scene_subsurface_tree_set_clip(&c->scene_surface->node, &clip);
+		}
+		c->configures_elided++;
+		return;
+	}
+
+	client_set_bounds(c, geo.width, geo.height);
+
 	/* Frame is 1 cell on each side (top has title, others are box chars) */
 	frame_inset = c->isfullscreen ? 0 : cell_width;
 
@@ -4149,8 +4861,12 @@ resize(Client *c, struct wlr_box geo, int interact)
 	wlr_scene_node_set_position(&c->scene_surface->node, frame_inset, 
 			c->isfullscreen ? 0 : cell_height);
 
-	/* Update text frame */
-	updateframe(c);
+	/* The frame is drawn from the size, not the position; a move alone
+	 * doesn't need it redrawn */
+	if (!c->frame_state_valid || c->frame_state.width != c->geom.width
+			|| c->frame_state.height != c->geom.height
+			|| c->sized_fullscreen != c->isfullscreen)
+		updateframe(c);
 
 	/* Content size is window size minus frame (1 cell each side) */
 	c->resize = client_set_size(c, 
@@ -4170,6 +4886,13 @@ resize(Client *c, struct wlr_box geo, int interact)
 			c->surface.xdg->geometry.x, c->surface.xdg->geometry.y,
 			c->surface.xdg->geometry.width, c->surface.xdg->geometry.height);
 	wlr_scene_subsurface_tree_set_clip(&c->scene_surface->node, &clip);
+
+	c->sized_geom = c->geom;
+	c->sized_clip = clip;
+	c->sized_font_serial = font_serial;
+	c->sized_fullscreen = c->isfullscreen;
+	c->sized_valid = 1;
+	c->configures_sent++;
 }
 
 void
@@ -4183,8 +4906,9 @@ run(char *startup_cmd)
 		die("startup: setenv WAYLAND_DISPLAY failed");
 	tbwm_log(TBWM_LOG_INFO, "tbwm: WAYLAND_DISPLAY=%s DISPLAY=%s\n", socket, getenv("DISPLAY") ? getenv("DISPLAY") : "(none)");
 
-	/* Start capturing stderr into the REPL pipe so runtime WARNING/ERROR from
-	 * libraries and our own code can be forwarded into the desktop REPL.
+	/* Start capturing stderr into the REPL pipe so WARNING/ERROR output from
+	 * code that doesn't go through tbwm_log() (Xwayland, spawned programs)
+	 * still reaches the log and the desktop REPL.
 	 * Create a non-blocking pipe and make the write end the process's stderr. */
 	{
 		int p[2];
@@ -4195,6 +4919,8 @@ run(char *startup_cmd)
 			int flags = fcntl(repl_stderr_fd, F_GETFL, 0);
 			if (flags >= 0)
 				fcntl(repl_stderr_fd, F_SETFL, flags | O_NONBLOCK);
+			/* Errors keep going to the real stderr, see log_line() */
+			log_stderr_fd = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
 			/* Replace STDERR with write end of pipe so fprintf(stderr,..) goes there */
 			if (dup2(repl_stderr_wfd, STDERR_FILENO) < 0) {
 				/* fall back: keep stderr as-is */
@@ -4202,6 +4928,9 @@ run(char *startup_cmd)
 				repl_stderr_fd = -1;
 				close(repl_stderr_wfd);
 				repl_stderr_wfd = -1;
+				if (log_stderr_fd >= 0)
+					close(log_stderr_fd);
+				log_stderr_fd = STDERR_FILENO;
 			} else {
 				/* Register event source to read from the pipe in the Wayland event loop */
 				struct wl_event_loop *ev = wl_display_get_event_loop(dpy);
@@ -4256,13 +4985,18 @@ run(char *startup_cmd)
 	wlr_cursor_warp_closest(cursor, NULL, cursor->x, cursor->y);
 	wlr_cursor_set_xcursor(cursor, cursor_mgr, "default");
 
-	/* Start bar update timer */
-	bar_timer = wl_event_loop_add_timer(event_loop, bartimer, NULL);
-	wl_event_source_timer_update(bar_timer, 1000);
+	/* Bar clock timer: fires on wall-clock second (or minute) boundaries */
+	clock_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (clock_fd >= 0) {
+		clock_source = wl_event_loop_add_fd(event_loop, clock_fd, WL_EVENT_READABLE, bartimer, NULL);
+		clockarm();
+	} else {
+		tbwm_log(TBWM_LOG_WARN, "tbwm: warning: timerfd_create() failed: %s\n", strerror(errno));
+	}
 
-	/* Start scroll timer (33ms = ~30fps for smooth scrolling) */
+	/* Scrolling titles are driven by output frames; this timer only paces
+	 * frames between whole-pixel steps and is armed by scrolltick() */
 	scroll_timer = wl_event_loop_add_timer(event_loop, scrolltimer, NULL);
-	wl_event_source_timer_update(scroll_timer, 33);
 
 	/* Run on-startup commands from config */
 	run_startup_commands();
@@ -4313,7 +5047,9 @@ setfloating(Client *c, int floating)
 {
 	Client *p = client_get_parent(c);
 	int was_floating = c->isfloating;
+	clientcount(c, -1);
 	c->isfloating = floating;
+	clientcount(c, 1);
 	
 	/* Handle dwindle tree updates */
 	if (floating && !was_floating && c->dwindle) {
@@ -4360,7 +5096,9 @@ setfloating(Client *c, int floating)
 void
 setfullscreen(Client *c, int fullscreen)
 {
+	clientcount(c, -1);
 	c->isfullscreen = fullscreen;
+	clientcount(c, 1);
 	if (!c->mon || !client_surface(c)->mapped)
 		return;
 	c->bw = fullscreen ? 0 : cfg_borderpx;
@@ -4410,13 +5148,65 @@ setmfact(const Arg *arg)
 	arrange(selmon);
 }
 
+/* Add (sign 1) or take back (sign -1) c's share of its monitor's client
+ * counts. Changes to c's monitor, tags, floating or fullscreen state
+ * happen between the two. */
+void
+clientcount(Client *c, int sign)
+{
+	Monitor *m = c->mon;
+	uint32_t tags;
+	int i;
+
+	if (!m)
+		return;
+	for (tags = c->tags, i = 0; tags && i < (int)LENGTH(m->tag_clients); tags >>= 1, i++)
+		if (tags & 1)
+			m->tag_clients[i] += sign;
+	if (!VISIBLEON(c, m))
+		return;
+	m->nvisible += sign;
+	if (c->isfloating)
+		m->nvisible_floating += sign;
+	else if (!c->isfullscreen)
+		m->nvisible_tiled += sign;
+}
+
+/* The visible counts after m's tagset changed; per-tag counts don't
+ * depend on it */
+void
+recountvisible(Monitor *m)
+{
+	Client *c;
+
+	m->nvisible = m->nvisible_tiled = m->nvisible_floating = 0;
+	wl_list_for_each(c, &m->clients, mlink) {
+		if (!VISIBLEON(c, m))
+			continue;
+		m->nvisible++;
+		if (c->isfloating)
+			m->nvisible_floating++;
+		else if (!c->isfullscreen)
+			m->nvisible_tiled++;
+	}
+}
+
 void
 setmon(Client *c, Monitor *m, uint32_t newtags)
 {
 	Monitor *oldmon = c->mon;
+	Client *next;
+	struct wl_list *l;
 
 	if (oldmon == m)
 		return;
+	/* Its dwindle tree belongs to the old monitor */
+	dwindle_remove(c);
+	if (oldmon) {
+		tileindex_remove(&oldmon->tiled, c);
+		clientcount(c, -1);
+		wl_list_remove(&c->mlink);
+	}
 	c->mon = m;
 	c->prev = c->geom;
 
@@ -4427,6 +5217,14 @@ setmon(Client *c, Monitor *m, uint32_t newtags)
 		/* Make sure window actually overlaps with the monitor */
 		resize(c, c->geom, 0);
 		c->tags = newtags ? newtags : m->tagset[m->seltags]; /* assign tags of target monitor */
+		/* Keep m->clients in the order of clients: before the next client
+		 * already on m. Not linked yet on the initial commit. */
+		for (l = c->link.next; l && l != &clients; l = l->next) {
+			if ((next = wl_container_of(l, next, link))->mon == m)
+				break;
+		}
+		wl_list_insert(l && l != &clients ? next->mlink.prev : m->clients.prev, &c->mlink);
+		clientcount(c, 1);
 		setfullscreen(c, c->isfullscreen); /* This will call arrange(c->mon) */
 		setfloating(c, c->isfloating);
 	}
@@ -4465,7 +5263,7 @@ setup(void)
 	for (i = 0; i < (int)LENGTH(sig); i++)
 		sigaction(sig[i], &sa, NULL);
 
-	wlr_log_init(cfg_log_level, NULL);
+	wlr_log_init(cfg_log_level, wlr_log_cb);
 	setupgrid();
 	buildappcache();
 	setup_foot_config();
@@ -4587,6 +5385,9 @@ setup(void)
 	 * https://drewdevault.com/2018/07/29/Wayland-shells.html
 	 */
 	wl_list_init(&clients);
+	wl_list_init(&border_strips);
+	wl_list_init(&titlebuf_pool);
+	wl_list_init(&glyph_atlases);
 	wl_list_init(&fstack);
 
 	/* Initialize REPL and load config (must be after layers and mons init) */
@@ -5076,6 +5877,22 @@ static s7_pointer scm_focused_title(s7_scheme *sc, s7_pointer args)
 	return s7_make_string(sc, client_get_title(c));
 }
 
+/* Scheme function: (configure-stats) - list of (app-id sent elided) per client */
+static s7_pointer scm_configure_stats(s7_scheme *sc, s7_pointer args)
+{
+	Client *c;
+	const char *appid;
+	s7_pointer result = s7_nil(sc);
+	wl_list_for_each(c, &clients, link) {
+		appid = client_get_appid(c);
+		result = s7_cons(sc, s7_list(sc, 3,
+				s7_make_string(sc, appid ? appid : "?"),
+				s7_make_integer(sc, c->configures_sent),
+				s7_make_integer(sc, c->configures_elided)), result);
+	}
+	return s7_reverse(sc, result);
+}
+
 /* Scheme function: (current-tag) - get current tag number */
 static s7_pointer scm_current_tag(s7_scheme *sc, s7_pointer args)
 {
@@ -5094,15 +5911,9 @@ static s7_pointer scm_current_tag(s7_scheme *sc, s7_pointer args)
 /* Scheme function: (window-count) - get number of visible windows */
 static s7_pointer scm_window_count(s7_scheme *sc, s7_pointer args)
 {
-	Client *c;
-	int count = 0;
 	if (!selmon)
 		return s7_make_integer(sc, 0);
-	wl_list_for_each(c, &clients, link) {
-		if (VISIBLEON(c, selmon))
-			count++;
-	}
-	return s7_make_integer(sc, count);
+	return s7_make_integer(sc, selmon->nvisible);
 }
 
 /* Scheme function: (log msg) - print message to stderr */
@@ -5162,12 +5973,49 @@ static s7_pointer scm_set_repl_log_level(s7_scheme *sc, s7_pointer args)
 	return s7_t(sc);
 }
 
+/* Scheme function: (set-repl-scrollback n) - keep the last n REPL lines */
+static s7_pointer scm_set_repl_scrollback(s7_scheme *sc, s7_pointer args)
+{
+	int n;
+	if (!s7_is_integer(s7_car(args)))
+		return s7_f(sc);
+	n = s7_integer(s7_car(args));
+	if (n < 1 || n > REPL_HISTORY_MAX)
+		return s7_f(sc);
+	if (repl_resize_history(n) < 0)
+		return s7_f(sc);
+	cfg_repl_scrollback = n;
+	if (repl_scroll_offset > repl_history_count)
+		repl_scroll_offset = repl_history_count;
+	updaterepl();
+	return s7_t(sc);
+}
+
+/* Scheme function: (set-file-log-level n) - set debug file log threshold (0=DEBUG,1=INFO,2=WARN,3=ERROR) */
+static s7_pointer scm_set_file_log_level(s7_scheme *sc, s7_pointer args)
+{
+	if (!s7_is_integer(s7_car(args)))
+		return s7_f(sc);
+	cfg_file_log_level = s7_integer(s7_car(args));
+	return s7_t(sc);
+}
+
 /* Scheme function: (set-title-scroll-mode mode) - set scroll mode (0=truncate, 1=scroll) */
 static s7_pointer scm_set_title_scroll_mode(s7_scheme *sc, s7_pointer args)
 {
 	if (!s7_is_integer(s7_car(args)))
 		return s7_f(sc);
 	title_scroll_mode = s7_integer(s7_car(args)) ? 1 : 0;
+	updateframes();
+	updatebars();
+	return s7_t(sc);
+}
+
+/* Scheme function: (set-text-atlas bool) - compose window titles from an uploaded glyph atlas */
+static s7_pointer scm_set_text_atlas(s7_scheme *sc, s7_pointer args)
+{
+	cfg_text_atlas = s7_boolean(sc, s7_car(args)) ? 1 : 0;
+	updateframes();
 	return s7_t(sc);
 }
 
@@ -5192,6 +6040,89 @@ static SchemeBinding *scheme_bindings = NULL;
 static int scheme_binding_count = 0;
 static int scheme_binding_capacity = 0;
 
+/* Hash index over scheme_bindings keyed on (CLEANMASK mods, lowercased
+ * keysym). A key press is resolved by probing each subset of the held
+ * modifiers instead of scanning every binding. */
+typedef struct {
+	uint32_t mod;
+	xkb_keysym_t keysym; /* lowercased */
+	int idx;             /* index into scheme_bindings, -1 if slot is empty */
+	int spec;            /* number of modifier bits (higher == more specific) */
+} BindingSlot;
+static BindingSlot *binding_table = NULL;
+static int binding_table_size = 0; /* power of two */
+static int binding_table_used = 0;
+
+static uint32_t
+binding_hash(uint32_t mod, xkb_keysym_t sym)
+{
+	return (sym * 2654435761u) ^ (mod * 40503u);
+}
+
+static BindingSlot *
+binding_table_find(uint32_t mod, xkb_keysym_t sym)
+{
+	uint32_t mask, i;
+
+	if (!binding_table_used)
+		return NULL;
+	mask = binding_table_size - 1;
+	for (i = binding_hash(mod, sym) & mask; binding_table[i].idx >= 0; i = (i + 1) & mask) {
+		if (binding_table[i].mod == mod && binding_table[i].keysym == sym)
+			return &binding_table[i];
+	}
+	return NULL;
+}
+
+static void
+binding_table_put(int idx)
+{
+	uint32_t mod = CLEANMASK(scheme_bindings[idx].mod);
+	xkb_keysym_t sym = xkb_keysym_to_lower(scheme_bindings[idx].keysym);
+	uint32_t mask = binding_table_size - 1;
+	uint32_t i;
+
+	for (i = binding_hash(mod, sym) & mask; binding_table[i].idx >= 0; i = (i + 1) & mask) {
+		/* Earlier binding wins, same as the old linear scan */
+		if (binding_table[i].mod == mod && binding_table[i].keysym == sym)
+			return;
+	}
+	binding_table[i].mod = mod;
+	binding_table[i].keysym = sym;
+	binding_table[i].idx = idx;
+	binding_table[i].spec = __builtin_popcount(mod);
+	binding_table_used++;
+}
+
+/* Index a freshly appended binding, growing the table to stay at most half
+ * full; returns 0 if it couldn't grow */
+static int
+binding_table_add(int idx)
+{
+	BindingSlot *tmp;
+	int i, newsize;
+
+	if ((binding_table_used + 1) * 2 > binding_table_size) {
+		newsize = binding_table_size ? binding_table_size * 2 : 64;
+		while ((binding_table_used + 1) * 2 > newsize)
+			newsize *= 2;
+		if (!(tmp = malloc(newsize * sizeof(*tmp)))) {
+			tbwm_log(TBWM_LOG_ERROR, "tbwm: out of memory growing binding table\n");
+			return 0;
+		}
+		free(binding_table);
+		binding_table = tmp;
+		binding_table_size = newsize;
+		binding_table_used = 0;
+		for (i = 0; i < newsize; i++)
+			binding_table[i].idx = -1;
+		for (i = 0; i < idx; i++)
+			binding_table_put(i);
+	}
+	binding_table_put(idx);
+	return 1;
+}
+
 static void
 ensure_scheme_bindings_capacity(int extra)
 {
@@ -5270,12 +6201,18 @@ static s7_pointer scm_bind_key(s7_scheme *sc, s7_pointer args)
 
 	/* Ensure capacity and append new binding */
 	ensure_scheme_bindings_capacity(1);
+	if (scheme_binding_count == scheme_binding_capacity)
+		return s7_f(sc);
+
+	scheme_bindings[scheme_binding_count].mod = mods;
+	scheme_bindings[scheme_binding_count].keysym = sym;
+	/* A binding the index can't hold would never fire */
+	if (!binding_table_add(scheme_binding_count))
+		return s7_f(sc);
 
 	/* Protect callback from GC - store protection location so we can unprotect on reload */
 	s7_int gc_loc = s7_gc_protect(sc, callback);
 
-	scheme_bindings[scheme_binding_count].mod = mods;
-	scheme_bindings[scheme_binding_count].keysym = sym;
 	scheme_bindings[scheme_binding_count].callback = callback;
 	scheme_bindings[scheme_binding_count].gc_loc = gc_loc;
 	scheme_binding_count++;
@@ -5297,6 +6234,9 @@ unbind_all_scheme_bindings(void)
 		scheme_bindings[i].gc_loc = -1;
 	}
 	scheme_binding_count = 0;
+	for (i = 0; i < binding_table_size; i++)
+		binding_table[i].idx = -1;
+	binding_table_used = 0;
 }
 
 /* Scheme function: (unbind-all) - remove all Scheme keybindings */
@@ -5309,35 +6249,31 @@ static s7_pointer scm_unbind_all(s7_scheme *sc, s7_pointer args)
 /* Check and execute Scheme keybindings - returns 1 if handled */
 int check_scheme_bindings(uint32_t mods, xkb_keysym_t sym)
 {
-	int i;
-	xkb_keysym_t sym_lower = xkb_keysym_to_lower(sym);
-	char symname[64] = {0};
-	xkb_keysym_get_name(sym, symname, sizeof(symname));
-	file_debug_log("tbwm: check_scheme_bindings: checking %d bindings for mods=0x%x sym=0x%x (%s)\n",
-				scheme_binding_count, mods, sym, symname[0] ? symname : "(no-name)");
-	int best_idx = -1;
-	int best_spec = -1; /* number of modifier bits in binding (higher == more specific) */
-	for (i = 0; i < scheme_binding_count; i++) {
-		xkb_keysym_t bound_lower = xkb_keysym_to_lower(scheme_bindings[i].keysym);
-		char boundname[64] = {0};
-		xkb_keysym_get_name(scheme_bindings[i].keysym, boundname, sizeof(boundname));
-		file_debug_log("tbwm: scheme idx=%d stored mod=0x%x sym=0x%x (%s)\n", i, scheme_bindings[i].mod, scheme_bindings[i].keysym, boundname[0] ? boundname : "(no-name)");
-		/* Collect best (most-specific) matching binding so that M-S-Left wins over M-Left when both exist. */
-		if ((CLEANMASK(mods) & CLEANMASK(scheme_bindings[i].mod)) == CLEANMASK(scheme_bindings[i].mod) && 
-		    (scheme_bindings[i].keysym == sym || bound_lower == sym_lower)) {
-			int spec = __builtin_popcount(CLEANMASK(scheme_bindings[i].mod));
-			if (spec > best_spec) {
-				best_spec = spec;
-				best_idx = i;
-			}
-		}
-	}
-	if (best_idx >= 0) {
-		tbwm_log(TBWM_LOG_INFO, "tbwm: scheme binding matched (idx=%d) mods=0x%x sym=0x%x (best_spec=%d)\n", best_idx, mods, sym, best_spec);
-		s7_call(sc, scheme_bindings[best_idx].callback, s7_nil(sc));
-		return 1;
+	uint32_t held = CLEANMASK(mods);
+	uint32_t sub = held;
+	xkb_keysym_t sym_lower;
+	BindingSlot *slot, *best = NULL;
+
+	if (!binding_table_used)
+		return 0;
+
+	/* Bindings match when their modifiers are a subset of the held ones.
+	 * Pick the most specific so that M-S-Left wins over M-Left when both exist. */
+	sym_lower = xkb_keysym_to_lower(sym);
+	for (;;) {
+		slot = binding_table_find(sub, sym_lower);
+		if (slot && (!best || slot->spec > best->spec
+				|| (slot->spec == best->spec && slot->idx < best->idx)))
+			best = slot;
+		if (!sub)
+			break;
+		sub = (sub - 1) & held;
 	}
-	return 0;
+	if (!best)
+		return 0;
+	tbwm_log(TBWM_LOG_INFO, "tbwm: scheme binding matched (idx=%d) mods=0x%x sym=0x%x (best_spec=%d)\n", best->idx, mods, sym, best->spec);
+	s7_call(sc, scheme_bindings[best->idx].callback, s7_nil(sc));
+	return 1;
 }
 
 /* ==================== SCHEME CONFIG SETTERS ==================== */
@@ -5367,6 +6303,7 @@ static s7_pointer scm_set_sloppy_focus(s7_scheme *sc, s7_pointer args) {
 static s7_pointer scm_set_bg_color(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	cfg_bg_color = parse_color_rgb(s7_string(s7_car(args)));
+	tile_cache_invalidate();
 	/* Update root background if it exists */
 	if (root_bg) {
 		float c[4];
@@ -5377,6 +6314,7 @@ static s7_pointer scm_set_bg_color(s7_scheme *sc, s7_pointer args) {
 		wlr_scene_rect_set_color(root_bg, c);
 	}
 	updatebars();
+	repl_invalidate();
 	return s7_t(sc);
 }
 
@@ -5384,7 +6322,9 @@ static s7_pointer scm_set_bg_color(s7_scheme *sc, s7_pointer args) {
 static s7_pointer scm_set_bg_text_color(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	cfg_bg_text_color = parse_color_rgb(s7_string(s7_car(args)));
+	tile_cache_invalidate();
 	updatebars();
+	repl_invalidate();
 	return s7_t(sc);
 }
 
@@ -5392,6 +6332,7 @@ static s7_pointer scm_set_bg_text_color(s7_scheme *sc, s7_pointer args) {
 static s7_pointer scm_set_border_color(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	cfg_border_color = parse_color_rgb(s7_string(s7_car(args)));
+	tile_cache_invalidate();
 	updateframes();
 	updatebars();
 	return s7_t(sc);
@@ -5401,6 +6342,7 @@ static s7_pointer scm_set_border_color(s7_scheme *sc, s7_pointer args) {
 static s7_pointer scm_set_border_line_color(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	cfg_border_line_color = parse_color_rgb(s7_string(s7_car(args)));
+	tile_cache_invalidate();
 	updateframes();
 	updatebars();
 	return s7_t(sc);
@@ -5410,6 +6352,7 @@ static s7_pointer scm_set_border_line_color(s7_scheme *sc, s7_pointer args) {
 static s7_pointer scm_set_bar_color(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	cfg_bar_color = parse_color_rgb(s7_string(s7_car(args)));
+	tile_cache_invalidate();
 	updatebars();
 	return s7_t(sc);
 }
@@ -5418,6 +6361,7 @@ static s7_pointer scm_set_bar_color(s7_scheme *sc, s7_pointer args) {
 static s7_pointer scm_set_bar_text_color(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	cfg_bar_text_color = parse_color_rgb(s7_string(s7_car(args)));
+	tile_cache_invalidate();
 	updatebars();
 	return s7_t(sc);
 }
@@ -5426,6 +6370,7 @@ static s7_pointer scm_set_bar_text_color(s7_scheme *sc, s7_pointer args) {
 static s7_pointer scm_set_menu_color(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	cfg_menu_color = parse_color_rgb(s7_string(s7_car(args)));
+	tile_cache_invalidate();
 	updateappmenu();
 	return s7_t(sc);
 }
@@ -5434,6 +6379,7 @@ static s7_pointer scm_set_menu_color(s7_scheme *sc, s7_pointer args) {
 static s7_pointer scm_set_menu_text_color(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	cfg_menu_text_color = parse_color_rgb(s7_string(s7_car(args)));
+	tile_cache_invalidate();
 	updateappmenu();
 	return s7_t(sc);
 }
@@ -5470,6 +6416,7 @@ static s7_pointer scm_set_tag_count(s7_scheme *sc, s7_pointer args) {
 /* Scheme: (set-show-time b) - show/hide time in status bar */
 static s7_pointer scm_set_show_time(s7_scheme *sc, s7_pointer args) {
 	cfg_show_time = s7_boolean(sc, s7_car(args)) ? 1 : 0;
+	clockarm();
 	updatebars();
 	return s7_t(sc);
 }
@@ -5477,6 +6424,7 @@ static s7_pointer scm_set_show_time(s7_scheme *sc, s7_pointer args) {
 /* Scheme: (set-show-date b) - show/hide date in status bar */
 static s7_pointer scm_set_show_date(s7_scheme *sc, s7_pointer args) {
 	cfg_show_date = s7_boolean(sc, s7_car(args)) ? 1 : 0;
+	clockarm();
 	updatebars();
 	return s7_t(sc);
 }
@@ -5486,6 +6434,7 @@ static s7_pointer scm_set_status_text(s7_scheme *sc, s7_pointer args) {
 	if (!s7_is_string(s7_car(args))) return s7_f(sc);
 	strncpy(cfg_status_text, s7_string(s7_car(args)), sizeof(cfg_status_text) - 1);
 	cfg_status_text[sizeof(cfg_status_text) - 1] = '\0';
+	clockarm();
 	updatebars();
 	return s7_t(sc);
 }
@@ -5548,6 +6497,9 @@ static s7_pointer scm_set_font(s7_scheme *sc, s7_pointer args) {
 			cell_height = ft_face->size->metrics.height >> 6;
 		}
 		tbwm_log(TBWM_LOG_INFO, "tbwm: font changed to %s %d (%dx%d cells)\n", cfg_font_path, cfg_font_size, cell_width, cell_height);
+		font_serial++;
+		tile_cache_invalidate();
+		repl_invalidate();
 		updateframes();
 		updatebars();
 	}
@@ -5569,6 +6521,9 @@ static s7_pointer scm_set_fallback_font(s7_scheme *sc, s7_pointer args) {
 		/* Invalidate glyph cache so new glyphs are loaded */
 		for (int i = 0; i < GLYPH_CACHE_SIZE; i++)
 			glyph_cache[i].valid = 0;
+		font_serial++;
+		tile_cache_invalidate();
+		repl_invalidate();
 		updateframes();
 		updatebars();
 	}
@@ -5720,9 +6675,129 @@ static s7_pointer scm_buffer_stats(s7_scheme *sc, s7_pointer args) {
 	char buf[512];
 	int buf_leaked = titlebuf_alloc_count - titlebuf_free_count;
 	int glyph_leaked = glyph_malloc_count - glyph_free_count;
-	snprintf(buf, sizeof(buf), "buf: alloc=%d free=%d leaked=%d | glyph: malloc=%d free=%d leaked=%d bytes=%zu", 
+	int strips = 0, strip_refs = 0;
+	BorderStrip *bs;
+	wl_list_for_each(bs, &border_strips, link) {
+		strips++;
+		strip_refs += bs->refs;
+	}
+	snprintf(buf, sizeof(buf), "buf: alloc=%d free=%d leaked=%d | glyph: malloc=%d free=%d leaked=%d bytes=%zu | frame: drawn=%lu skipped=%lu | strips: shared=%d refs=%d | atlas: uploads=%lu | bar: drawn=%lu skipped=%lu | damage: last=%lu total=%lu clean=%lu | pool: reused=%lu storage=%lu | tile: hit=%lu miss=%lu", 
 	         titlebuf_alloc_count, titlebuf_free_count, buf_leaked,
-	         glyph_malloc_count, glyph_free_count, glyph_leaked, glyph_total_bytes);
+	         glyph_malloc_count, glyph_free_count, glyph_leaked, glyph_total_bytes,
+	         frame_redraw_count, frame_skip_count, strips, strip_refs, atlas_upload_count,
+	         bar_seg_draw_count, bar_seg_skip_count, damage_px_last, damage_px_total,
+	         damage_clean_count, titlebuf_reuse_count, pixstore_reuse_count, tile_hit_count, tile_miss_count);
+	return s7_make_string(sc, buf);
+}
+
+/* Scheme: (bench-cells n) - time n cells through the glyph blend and the tile copy */
+static s7_pointer scm_bench_cells(s7_scheme *sc, s7_pointer args) {
+	char buf[256];
+	struct timespec t0, t1;
+	uint32_t *pixels;
+	uint32_t fg = RGB_TO_ARGB(cfg_border_line_color);
+	uint32_t bg = RGB_TO_ARGB(cfg_border_color);
+	int cols = 80, rows = 25;
+	int w = cols * cell_width, h = rows * cell_height;
+	long n, i, j;
+	double blend_s, tile_s;
+	static const char sample[] = "tbwm 0123456789 [F]=[X] abcdefghijklmnopqrstuvwxyz";
+
+	if (!s7_is_integer(s7_car(args)) || (n = s7_integer(s7_car(args))) <= 0)
+		return s7_f(sc);
+	if (!(pixels = calloc((size_t)w * h, sizeof(uint32_t))))
+		return s7_f(sc);
+
+	/* Old path: background fill per cell plus per-pixel glyph blend */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < n; i++) {
+		int x = (i % cols) * cell_width, y = (i / cols % rows) * cell_height;
+		for (j = 0; j < cell_height; j++) {
+			int k;
+			for (k = 0; k < cell_width; k++)
+				pixels[(y + j) * w + x + k] = bg;
+		}
+		render_char_to_buffer(pixels, w, h, x, y, (unsigned char)sample[i % (sizeof(sample) - 1)], fg);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	blend_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	/* New path: pre-tinted tile, one memcpy per row */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < n; i++)
+		draw_cell(pixels, w, h, (i % cols) * cell_width, (i / cols % rows) * cell_height,
+			(unsigned char)sample[i % (sizeof(sample) - 1)], fg, bg);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	tile_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	free(pixels);
+	snprintf(buf, sizeof(buf), "glyph blend: %.0f cells/s | tile copy: %.0f cells/s",
+	         blend_s > 0 ? n / blend_s : 0.0, tile_s > 0 ? n / tile_s : 0.0);
+	return s7_make_string(sc, buf);
+}
+
+/* Scheme: (bench-directions n) - time n directional lookups among 200 tiled windows */
+static s7_pointer scm_bench_directions(s7_scheme *sc, s7_pointer args) {
+	char buf[256];
+	struct timespec t0, t1;
+	TileIndex ix = {0};
+	Client *fake;
+	Client *volatile pick; /* keeps the timed lookups from being optimized out */
+	int cols = 20, rows = 10, count = cols * rows, w = 12 * cell_width, h = 6 * cell_height;
+	long n, i, j, mismatches = 0;
+	double scan_s, index_s;
+
+	if (!s7_is_integer(s7_car(args)) || (n = s7_integer(s7_car(args))) <= 0)
+		return s7_f(sc);
+	if (!(fake = calloc(count, sizeof(*fake))) || !tileindex_reserve(&ix, count)) {
+		free(fake);
+		free(ix.by_x);
+		free(ix.by_y);
+		return s7_f(sc);
+	}
+	/* A grid of tiles sharing a 1-cell border, every other row offset by
+	 * half a tile so directional lookups have partial overlaps to rank */
+	for (i = 0; i < count; i++) {
+		fake[i].geom.x = (i % cols) * (w - cell_width) + (i / cols % 2) * (w / 2);
+		fake[i].geom.y = (i / cols) * (h - cell_height);
+		fake[i].geom.width = w;
+		fake[i].geom.height = h;
+		ix.by_x[ix.n++] = &fake[i];
+	}
+	tileindex_sort(&ix);
+
+	/* Old path: score every window */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < n; i++) {
+		DirPick p = {0};
+		for (j = 0; j < count; j++)
+			dir_consider(&p, &fake[i % count], &fake[j], i % 4);
+		pick = p.best;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	scan_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	/* New path: sorted edge lists */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < n; i++)
+		pick = tileindex_dir(&ix, &fake[i % count], i % 4);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	index_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	/* Both have to agree on every window and direction */
+	for (i = 0; i < count * 4; i++) {
+		DirPick p = {0};
+		for (j = 0; j < count; j++)
+			dir_consider(&p, &fake[i / 4], &fake[j], i % 4);
+		mismatches += p.best != tileindex_dir(&ix, &fake[i / 4], i % 4);
+	}
+	(void)pick;
+
+	free(ix.by_x);
+	free(ix.by_y);
+	free(fake);
+	snprintf(buf, sizeof(buf), "%d windows | scan: %.0f lookups/s | index: %.0f lookups/s | mismatches: %ld",
+	         count, scan_s > 0 ? n / scan_s : 0.0, index_s > 0 ? n / index_s : 0.0, mismatches);
 	return s7_make_string(sc, buf);
 }
 
@@ -5744,7 +6819,9 @@ setup_scheme(void)
 	s7_define_function(sc, "refresh", scm_refresh, 0, 0, false, "(refresh) refresh layout");
 	s7_define_function(sc, "toggle-launcher", scm_toggle_launcher, 0, 0, false, "(toggle-launcher) open/close launcher");
 	s7_define_function(sc, "toggle-repl", scm_toggle_repl, 0, 0, false, "(toggle-repl) open/close Scheme REPL");
+	s7_define_function(sc, "set-repl-scrollback", scm_set_repl_scrollback, 1, 0, false, "(set-repl-scrollback n) keep the last n REPL lines (default 256)");
 	s7_define_function(sc, "set-repl-log-level", scm_set_repl_log_level, 1, 0, false, "(set-repl-log-level n) set REPL log threshold (0=DEBUG,1=INFO,2=WARN,3=ERROR)");
+	s7_define_function(sc, "set-file-log-level", scm_set_file_log_level, 1, 0, false, "(set-file-log-level n) set debug file log threshold (0=DEBUG,1=INFO,2=WARN,3=ERROR)");
 	s7_define_function(sc, "move-window", scm_move_window, 0, 0, false, "(move-window) start moving focused window with mouse");
 	s7_define_function(sc, "resize-window", scm_resize_window, 0, 0, false, "(resize-window) start resizing focused window with mouse");
 	s7_define_function(sc, "focus-monitor", scm_focus_monitor, 1, 0, false, "(focus-monitor dir) focus monitor in direction");
@@ -5774,12 +6851,14 @@ setup_scheme(void)
 	/* Queries */
 	s7_define_function(sc, "focused-app-id", scm_focused_app_id, 0, 0, false, "(focused-app-id) get app_id of focused window");
 	s7_define_function(sc, "focused-title", scm_focused_title, 0, 0, false, "(focused-title) get title of focused window");
+	s7_define_function(sc, "configure-stats", scm_configure_stats, 0, 0, false, "(configure-stats) list of (app-id sent elided) configure counts per client");
 	s7_define_function(sc, "current-tag", scm_current_tag, 0, 0, false, "(current-tag) get current tag number");
 	s7_define_function(sc, "window-count", scm_window_count, 0, 0, false, "(window-count) get number of visible windows");
-	s7_define_function(sc, "log", scm_log, 1, 0, false, "(log msg) print message to stderr");
+	s7_define_function(sc, "log", scm_log, 1, 0, false, "(log msg) write message to the log");
 	s7_define_function(sc, "help", scm_help, 0, 0, false, "(help) show available commands");
 	s7_define_function(sc, "chvt", scm_chvt, 1, 0, false, "(chvt n) switch to virtual terminal n");
 	s7_define_function(sc, "set-title-scroll-mode", scm_set_title_scroll_mode, 1, 0, false, "(set-title-scroll-mode mode) set title overflow mode: 0=truncate, 1=scroll");
+	s7_define_function(sc, "set-text-atlas", scm_set_text_atlas, 1, 0, false, "(set-text-atlas bool) draw window titles as scene nodes over a shared glyph atlas");
 	s7_define_function(sc, "set-title-scroll-speed", scm_set_title_scroll_speed, 1, 0, false, "(set-title-scroll-speed speed) set scroll speed in pixels per tick");
 
 	/* Configuration setters - NEW CLEAN API */
@@ -5800,6 +6879,8 @@ setup_scheme(void)
 	s7_define_function(sc, "set-sloppy-focus", scm_set_sloppy_focus, 1, 0, false, "(set-sloppy-focus b) enable/disable focus follows mouse");
 	s7_define_function(sc, "on-startup", scm_on_startup, 0, 0, true, "(on-startup cmd1 cmd2 ...) register commands to run on startup");
 	s7_define_function(sc, "buffer-stats", scm_buffer_stats, 0, 0, false, "(buffer-stats) show buffer alloc/free counts for leak detection");
+	s7_define_function(sc, "bench-cells", scm_bench_cells, 1, 0, false, "(bench-cells n) compare cells/s of glyph blending and cached tile copies");
+	s7_define_function(sc, "bench-directions", scm_bench_directions, 1, 0, false, "(bench-directions n) compare directional lookups/s of a full scan and the tile index");
 	
 	/* Font and input */
 	s7_define_function(sc, "set-font", scm_set_font, 2, 0, false, "(set-font path size) set grid font");
@@ -6313,127 +7394,252 @@ buildappcache(void)
 	tbwm_log(TBWM_LOG_INFO, "Built app cache: %d entries", app_cache_count);
 }
 
+/* Clock tick: only the clock segment of awake outputs is looked at; it is
+ * redrawn if the formatted text actually changed. */
 int
-bartimer(void *data)
+bartimer(int fd, uint32_t mask, void *data)
 {
-	/* Used for clock updates */
-	updatebars();
-	wl_event_source_timer_update(bar_timer, 1000);
+	uint64_t expirations;
+	Monitor *m;
+
+	/* ECANCELED after the wall clock was set; re-arming below handles it */
+	if (read(fd, &expirations, sizeof(expirations)) < 0
+			&& errno != EAGAIN && errno != ECANCELED)
+		tbwm_log(TBWM_LOG_ERROR, "tbwm: read(clock_fd) failed: %s\n", strerror(errno));
+
+	wl_list_for_each(m, &mons, link) {
+		if (!m->wlr_output->enabled || m->asleep || !m->clock_len)
+			continue;
+		m->clock_dirty = 1;
+		schedule_ui_frame(m);
+	}
+	clockarm();
 	return 0;
 }
 
+/* Arm the clock timer for the next second, or the next minute when only the
+ * date is shown, as an absolute time so ticks don't drift. Disarmed when the
+ * bar shows no clock. */
+void
+clockarm(void)
+{
+	struct itimerspec its = {0};
+	struct timespec now;
+	int step = cfg_show_time ? 1 : 60;
+
+	if (clock_fd < 0)
+		return;
+	if (!cfg_status_text[0] && (cfg_show_date || cfg_show_time)) {
+		clock_gettime(CLOCK_REALTIME, &now);
+		its.it_value.tv_sec = (now.tv_sec / step + 1) * step;
+	}
+	if (timerfd_settime(clock_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL) < 0)
+		tbwm_log(TBWM_LOG_ERROR, "tbwm: timerfd_settime() failed: %s\n", strerror(errno));
+}
+
+/* Fires only while titles scroll but no output produced a frame since the
+ * last whole-pixel step (the step itself damaged nothing yet). */
 int
 scrolltimer(void *data)
 {
-	Client *c;
-	int scroll_count = 0;
-    
-	/* Handle smooth scrolling for window titlebars and top-bar tabs.
-	 * Dynamically detect whether anything needs scrolling so we always
-	 * run the fast tick while any title/tab is scrolling. */
-	if (!title_scroll_mode) {
-		wl_event_source_timer_update(scroll_timer, 100);
-		return 0;
+	Monitor *m;
+
+	wl_list_for_each(m, &mons, link) {
+		if (m->scrolling > 0 && m->wlr_output->enabled && !m->asleep)
+			wlr_output_schedule_frame(m->wlr_output);
 	}
+	return 0;
+}
 
-	/* Detect whether any client or top-bar tab needs scrolling now. */
-	int needs_scroll = 0;
-	wl_list_for_each(c, &clients, link) {
-		if (c->needs_title_scroll) { needs_scroll = 1; break; }
-	}
-	if (!needs_scroll) {
-		/* Check top-bar tabs per monitor */
-		Monitor *m;
-		wl_list_for_each(m, &mons, link) {
-			int visible_count = 0;
-			Client *cc;
-			wl_list_for_each(cc, &clients, link) {
-				if (VISIBLEON(cc, m)) visible_count++;
-			}
-			if (visible_count <= 0) continue;
-
-			int width = m->m.width;
-			int n = 30 * cell_width; /* reserved for date/time */
-			int tab_area_width = width - /* x start unknown here; approximate */ (n + cell_width*10);
-			if (tab_area_width <= 0) continue;
-
-			int max_tab_chars = 20;
-			int tab_width_cells = max_tab_chars + 2;
-
-			wl_list_for_each(cc, &clients, link) {
-				if (!VISIBLEON(cc, m)) continue;
-				const char *title = client_get_title(cc);
-				if (!title) title = "?";
-				int title_len = 0; while (title[title_len]) title_len++;
-				int title_max = tab_width_cells - 2;
-				if (title_len > title_max - 1) { needs_scroll = 1; break; }
-			}
-			if (needs_scroll) break;
-		}
+/* Count things that need the scroll animation, in total and per output m
+ * (NULL for a client on no output). Going from none to some kicks the
+ * outputs; going back to none disarms the pacing timer, so an idle desktop
+ * has no scroll wakeups at all. */
+void
+scrollref(Monitor *m, int delta)
+{
+	int was = scrolling_titles;
+
+	if (m)
+		m->scrolling += delta;
+	scrolling_titles += delta;
+	if (!was && scrolling_titles > 0) {
+		scroll_last.tv_sec = scroll_last.tv_nsec = 0;
+		scrolltimer(NULL);
+	} else if (was && scrolling_titles <= 0) {
+		scrolling_titles = 0;
+		if (scroll_timer)
+			wl_event_source_timer_update(scroll_timer, 0);
 	}
+}
 
-	if (!needs_scroll) {
-		/* No scrolling needed, check again later */
-		any_title_needs_scroll = 0;
-		wl_event_source_timer_update(scroll_timer, 100);
-		return 0;
+/* Advance scrolling titles from rendermon(). The offset follows wall time
+ * (`title_scroll_speed` pixels/sec), so outputs with different refresh
+ * rates share one animation. A whole-pixel step moves marquee source boxes,
+ * which damages their outputs and brings the next frame; between steps the
+ * timer is armed for the next one. */
+void
+scrolltick(Monitor *m, const struct timespec *now)
+{
+	Client *c;
+	Monitor *bm;
+	int i, advance;
+	double dt;
+
+	if (!title_scroll_mode || !m->wlr_output->enabled || m->asleep)
+		return;
+
+	if (scroll_last.tv_sec || scroll_last.tv_nsec) {
+		dt = (now->tv_sec - scroll_last.tv_sec)
+			+ (now->tv_nsec - scroll_last.tv_nsec) / 1e9;
+		/* Don't jump ahead after outputs slept */
+		if (dt > 0.1)
+			dt = 0.1;
+		if (dt > 0)
+			title_scroll_accum += title_scroll_speed * dt;
 	}
-	any_title_needs_scroll = 1;
-	
-	/* Advance scroll offset according to `title_scroll_speed` (pixels/sec).
-	 * Use an accumulator to handle fractional pixels per tick. */
-	title_scroll_accum += title_scroll_speed * (33.0 / 1000.0);
-	int advance = (int)title_scroll_accum;
+	scroll_last = *now;
+
+	advance = (int)title_scroll_accum;
 	if (advance > 0) {
 		title_scroll_offset += advance;
 		title_scroll_accum -= advance;
-	}
-	
-	/* Only update windows that actually need scrolling */
-	wl_list_for_each(c, &clients, link) {
-		if (c->needs_title_scroll) {
-			updateframe(c);
-			scroll_count++;
+
+		/* Scrolling titles are marquees: a step only moves their source boxes */
+		wl_list_for_each(c, &clients, link)
+			marquee_scroll(&c->title_marquee);
+
+		/* A bar with more scrolling tabs than marquees draws the rest
+		 * itself and must be redrawn */
+		wl_list_for_each(bm, &mons, link) {
+			for (i = 0; i < MAX_TAB_MARQUEES; i++)
+				marquee_scroll(&bm->tab_marquee[i]);
+			if (bm->tab_marquee_overflow)
+				updatebar(bm);
 		}
 	}
 
-	/* Also update the top bar so tabs in the bar scroll smoothly */
-	updatebars();
+	if (scroll_timer)
+		wl_event_source_timer_update(scroll_timer,
+			(int)((1.0 - title_scroll_accum) * 1000.0 / title_scroll_speed) + 1);
+}
 
-	/* If no windows needed scrolling, clear the flag (bar may still scroll) */
-	if (scroll_count == 0) {
-		/* keep any_title_needs_scroll set because top-bar may still be scrolling */
-	}
-	
-	/* Continue at ~30fps */
-	wl_event_source_timer_update(scroll_timer, 33);
-	return 0;
+/* The update* functions below only mark UI dirty and schedule a frame;
+ * renderdirty() draws each dirty item once, from rendermon(), so a handler
+ * (or a config full of setters) that asks for many updates costs one redraw. */
+static void
+schedule_ui_frame(Monitor *m)
+{
+	if (m && m->wlr_output && m->wlr_output->enabled)
+		wlr_output_schedule_frame(m->wlr_output);
+}
+
+void
+updatebar(Monitor *m)
+{
+	if (!m)
+		return;
+	m->bar_dirty = 1;
+	schedule_ui_frame(m);
 }
 
 void
 updatebars(void)
 {
 	Monitor *m;
-	/* Don't update if not fully initialized */
-	if (!layers[LyrOverlay])
-		return;
-	/* Reset scroll flag - will be set by updatebar/updateframe if needed */
-	any_title_needs_scroll = 0;
 	wl_list_for_each(m, &mons, link)
 		updatebar(m);
 }
 
+void
+updateframe(Client *c)
+{
+	if (!c)
+		return;
+	c->frame_dirty = 1;
+	frames_dirty = 1;
+	schedule_ui_frame(c->mon);
+}
+
 void
 updateframes(void)
 {
 	Client *c;
-	/* Update all client frames for scrolling titles */
-	if (!title_scroll_mode)
-		return;
 	wl_list_for_each(c, &clients, link)
 		updateframe(c);
 }
 
+void
+updateappmenu(void)
+{
+	appmenu_dirty = 1;
+	schedule_ui_frame(selmon);
+}
+
+/* UI buffers are drawn at logical size, one pixel per cell pixel, and
+ * scaled up by the renderer. On an integer scale nearest-neighbour keeps
+ * every cell pixel a crisp square; fractional scales can't map pixels
+ * evenly, so they keep the default bilinear filter. */
+void
+updateuifilter(Monitor *m)
+{
+	float scale = m->wlr_output->scale;
+	enum wlr_scale_filter_mode f = scale == floorf(scale)
+		? WLR_SCALE_FILTER_NEAREST : WLR_SCALE_FILTER_BILINEAR;
+	Client *c;
+
+	if (f == m->ui_filter)
+		return;
+	m->ui_filter = f;
+	/* Nodes pick the filter up as they are drawn */
+	wl_list_for_each(c, &m->clients, mlink)
+		updateframe(c);
+	m->repl_dirty = 1;
+	updateappmenu();
+}
+
+void
+ui_filter_set(struct wlr_scene_buffer *b, Monitor *m)
+{
+	if (b)
+		wlr_scene_buffer_set_filter_mode(b, m ? m->ui_filter : WLR_SCALE_FILTER_NEAREST);
+}
+
+/* Draw everything marked dirty. Frames and the app menu are global and drawn
+ * by whichever output renders first; bars and the REPL are per monitor. */
+void
+renderdirty(Monitor *m)
+{
+	Client *c;
+
+	if (appmenu_dirty) {
+		appmenu_dirty = 0;
+		renderappmenu();
+	}
+	if (frames_dirty) {
+		frames_dirty = 0;
+		wl_list_for_each(c, &clients, link) {
+			if (c->frame_dirty) {
+				c->frame_dirty = 0;
+				renderframe(c);
+			}
+		}
+	}
+	if (m->bar_dirty) {
+		/* Don't draw the bar before the scene is ready */
+		if (layers[LyrOverlay]) {
+			m->bar_dirty = 0;
+			renderbar(m);
+		}
+	}
+	if (m->clock_dirty) {
+		m->clock_dirty = 0;
+		renderclock(m);
+	}
+	if (m->repl_dirty)
+		renderrepl(m);
+}
+
 void
 togglelauncher(const Arg *arg)
 {
@@ -6655,9 +7861,8 @@ toggleappmenu(const Arg *arg)
 }
 
 void
-updateappmenu(void)
+renderappmenu(void)
 {
-	struct TitleBuffer *tb;
 	uint32_t *pixels;
 	int menu_cells_w = 25;
 	int menu_cells_h = 25;
@@ -6677,16 +7882,7 @@ updateappmenu(void)
 		return;
 	}
 	
-	/* Reuse cached buffer or allocate new one */
-	if (!appmenu_tb) {
-		appmenu_tb = ecalloc(1, sizeof(*appmenu_tb));
-		appmenu_tb->stride = menu_width * 4;
-		appmenu_tb->data = ecalloc(1, appmenu_tb->stride * menu_height);
-		wlr_buffer_init(&appmenu_tb->base, &titlebuf_impl, menu_width, menu_height);
-		titlebuf_alloc_count++;
-	}
-	tb = appmenu_tb;
-	pixels = tb->data;
+	pixels = draw_scratch(menu_width, menu_height);
 	
 	/* Fill entire background with content color first */
 	for (i = 0; i < menu_width * menu_height; i++) {
@@ -6721,13 +7917,13 @@ updateappmenu(void)
 	
 	/* Draw box-drawing characters for the frame */
 	/* Top-left corner ╔ */
-	render_char_to_buffer(pixels, menu_width, menu_height, 0, 0, 0x2554, line_color);
+	draw_cell(pixels, menu_width, menu_height, 0, 0, 0x2554, line_color, frame_bg);
 	/* Top-right corner ╗ */
-	render_char_to_buffer(pixels, menu_width, menu_height, (menu_cells_w - 1) * cell_width, 0, 0x2557, line_color);
+	draw_cell(pixels, menu_width, menu_height, (menu_cells_w - 1) * cell_width, 0, 0x2557, line_color, frame_bg);
 	/* Bottom-left corner ╚ */
-	render_char_to_buffer(pixels, menu_width, menu_height, 0, (menu_cells_h - 1) * cell_height, 0x255A, line_color);
+	draw_cell(pixels, menu_width, menu_height, 0, (menu_cells_h - 1) * cell_height, 0x255A, line_color, frame_bg);
 	/* Bottom-right corner ╝ */
-	render_char_to_buffer(pixels, menu_width, menu_height, (menu_cells_w - 1) * cell_width, (menu_cells_h - 1) * cell_height, 0x255D, line_color);
+	draw_cell(pixels, menu_width, menu_height, (menu_cells_w - 1) * cell_width, (menu_cells_h - 1) * cell_height, 0x255D, line_color, frame_bg);
 	
 	/* Top edge ═ with title "Menu" */
 	{
@@ -6736,23 +7932,23 @@ updateappmenu(void)
 		int title_start = 2; /* start after ╔═ */
 		for (col = 1; col < menu_cells_w - 1; col++) {
 			if (col >= title_start && col < title_start + title_len) {
-				render_char_to_buffer(pixels, menu_width, menu_height, col * cell_width, 0, title[col - title_start], line_color);
+				draw_cell(pixels, menu_width, menu_height, col * cell_width, 0, title[col - title_start], line_color, frame_bg);
 			} else {
-				render_char_to_buffer(pixels, menu_width, menu_height, col * cell_width, 0, 0x2550, line_color);
+				draw_cell(pixels, menu_width, menu_height, col * cell_width, 0, 0x2550, line_color, frame_bg);
 			}
 		}
 	}
 	/* Bottom edge ═ */
 	for (col = 1; col < menu_cells_w - 1; col++) {
-		render_char_to_buffer(pixels, menu_width, menu_height, col * cell_width, (menu_cells_h - 1) * cell_height, 0x2550, line_color);
+		draw_cell(pixels, menu_width, menu_height, col * cell_width, (menu_cells_h - 1) * cell_height, 0x2550, line_color, frame_bg);
 	}
 	/* Left edge ║ */
 	for (row = 1; row < menu_cells_h - 1; row++) {
-		render_char_to_buffer(pixels, menu_width, menu_height, 0, row * cell_height, 0x2551, line_color);
+		draw_cell(pixels, menu_width, menu_height, 0, row * cell_height, 0x2551, line_color, frame_bg);
 	}
 	/* Right edge ║ */
 	for (row = 1; row < menu_cells_h - 1; row++) {
-		render_char_to_buffer(pixels, menu_width, menu_height, (menu_cells_w - 1) * cell_width, row * cell_height, 0x2551, line_color);
+		draw_cell(pixels, menu_width, menu_height, (menu_cells_w - 1) * cell_width, row * cell_height, 0x2551, line_color, frame_bg);
 	}
 	
 	/* Draw content: categories or apps */
@@ -6772,6 +7968,7 @@ updateappmenu(void)
 				int ci;
 				int is_selected = (row == menu_selected_row);
 				uint32_t row_fg = is_selected ? highlight_fg : text_color;
+				uint32_t row_bg = is_selected ? highlight_bg : content_bg;
 				
 				/* Highlight background if selected */
 				if (is_selected) {
@@ -6785,9 +7982,9 @@ updateappmenu(void)
 				
 				/* Draw category name */
 				for (ci = 0; cat_name[ci] && ci < max_text_len; ci++) {
-					render_char_to_buffer(pixels, menu_width, menu_height,
+					draw_cell(pixels, menu_width, menu_height,
 						text_x + ci * cell_width, text_y,
-						cat_name[ci], row_fg);
+						cat_name[ci], row_fg, row_bg);
 				}
 			}
 		} else {
@@ -6796,11 +7993,12 @@ updateappmenu(void)
 			int app_idx = 0;
 			int displayed = 0;
 			int is_selected;
-			uint32_t row_fg;
+			uint32_t row_fg, row_bg;
 			
 			/* First row: "< Back" */
 			is_selected = (menu_selected_row == 0);
 			row_fg = is_selected ? highlight_fg : text_color;
+			row_bg = is_selected ? highlight_bg : content_bg;
 			{
 				int text_y = cell_height;
 				const char *back = "< Back";
@@ -6816,9 +8014,9 @@ updateappmenu(void)
 				}
 				
 				for (bi = 0; back[bi] && bi < max_text_len; bi++) {
-					render_char_to_buffer(pixels, menu_width, menu_height,
+					draw_cell(pixels, menu_width, menu_height,
 						cell_width + bi * cell_width, text_y,
-						back[bi], row_fg);
+						back[bi], row_fg, row_bg);
 				}
 			}
 			
@@ -6833,6 +8031,7 @@ updateappmenu(void)
 						
 						is_selected = (displayed + 1 == menu_selected_row);
 						row_fg = is_selected ? highlight_fg : text_color;
+						row_bg = is_selected ? highlight_bg : content_bg;
 						
 						if (is_selected) {
 							int px, py;
@@ -6845,9 +8044,9 @@ updateappmenu(void)
 						
 						/* Draw app name */
 						for (ai = 0; app_name[ai] && ai < max_text_len; ai++) {
-							render_char_to_buffer(pixels, menu_width, menu_height,
+							draw_cell(pixels, menu_width, menu_height,
 								text_x + ai * cell_width, text_y,
-								app_name[ai], row_fg);
+								app_name[ai], row_fg, row_bg);
 						}
 						displayed++;
 					}
@@ -6867,7 +8066,8 @@ updateappmenu(void)
 	} else {
 		wlr_scene_node_set_position(&appmenu_buffer->node, sgeom.x, sgeom.y + cell_height);
 	}
-	wlr_scene_buffer_set_buffer(appmenu_buffer, &tb->base);
+	buffer_commit(appmenu_buffer, &appmenu_tb, menu_width, menu_height);
+	ui_filter_set(appmenu_buffer, selmon);
 	/* Don't drop - we're caching the buffer for reuse */
 }
 
@@ -6879,49 +8079,203 @@ reload_config_key(const Arg *arg)
 	tbwm_log(TBWM_LOG_INFO, "tbwm: config reloaded via keybinding\n");
 }
 
-void
+/* Scrollback line idx, 0 = oldest */
+static char *
+repl_history_line(int idx)
+{
+	return repl_arena + (size_t)((repl_head + idx) % repl_capacity) * REPL_LINE_LEN;
+}
+
+/* Move the scrollback into a new arena of the given capacity, keeping the
+ * newest lines that fit */
+int
+repl_resize_history(int capacity)
+{
+	char *arena;
+	unsigned short *lens;
+	int i, keep, skip;
+
+	arena = malloc((size_t)capacity * REPL_LINE_LEN);
+	lens = malloc(capacity * sizeof(*lens));
+	if (!arena || !lens) {
+		free(arena);
+		free(lens);
+		tbwm_log(TBWM_LOG_ERROR, "tbwm: out of memory for %d lines of REPL scrollback\n", capacity);
+		return -1;
+	}
+
+	keep = MIN(repl_history_count, capacity);
+	skip = repl_history_count - keep;
+	for (i = 0; i < keep; i++) {
+		memcpy(arena + (size_t)i * REPL_LINE_LEN, repl_history_line(skip + i), REPL_LINE_LEN);
+		lens[i] = repl_line_len[(repl_head + skip + i) % repl_capacity];
+	}
+
+	free(repl_arena);
+	free(repl_line_len);
+	repl_arena = arena;
+	repl_line_len = lens;
+	repl_capacity = capacity;
+	repl_head = 0;
+	repl_history_count = keep;
+	return 0;
+}
+
+void
 repl_add_line(const char *line)
 {
-	if (repl_history_count < REPL_HISTORY_LINES) {
-		strncpy(repl_history[repl_history_count], line, REPL_LINE_LEN - 1);
-		repl_history[repl_history_count][REPL_LINE_LEN - 1] = '\0';
+	char *dst;
+	size_t len;
+
+	if (repl_capacity != cfg_repl_scrollback && repl_resize_history(cfg_repl_scrollback) < 0)
+		return;
+
+	/* Append in O(1); when full, the new line overwrites the oldest */
+	if (repl_history_count < repl_capacity) {
+		dst = repl_history_line(repl_history_count);
 		repl_history_count++;
 	} else {
-		/* Scroll buffer up */
-		int i;
-		for (i = 0; i < REPL_HISTORY_LINES - 1; i++) {
-			strcpy(repl_history[i], repl_history[i + 1]);
-		}
-		strncpy(repl_history[REPL_HISTORY_LINES - 1], line, REPL_LINE_LEN - 1);
-		repl_history[REPL_HISTORY_LINES - 1][REPL_LINE_LEN - 1] = '\0';
-	}
+		dst = repl_history_line(0);
+		repl_head = (repl_head + 1) % repl_capacity;
+	}
+	len = strnlen(line, REPL_LINE_LEN - 1);
+	memcpy(dst, line, len);
+	dst[len] = '\0';
+	repl_line_len[(dst - repl_arena) / REPL_LINE_LEN] = len;
+	repl_line_seq++;
 	repl_scroll_offset = 0;
 	updaterepl();
 }
 
+/* ==================== LOGGING ==================== */
+
+/* Log lines collect in log_ring and are written to the debug file in one
+ * batch from an idle callback, so callers never wait on the filesystem
+ * unless the ring fills up within a single event loop iteration. */
 void
-tbwm_log(int level, const char *fmt, ...)
+log_flush(void)
+{
+	size_t off = 0;
+	ssize_t w;
+
+	if (!log_ring_len)
+		return;
+	if (log_fd < 0)
+		log_fd = open("/tmp/tbwm-debug.log", O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	while (log_fd >= 0 && off < log_ring_len) {
+		if ((w = write(log_fd, log_ring + off, log_ring_len - off)) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		off += w;
+	}
+	log_ring_len = 0;
+}
+
+static void
+log_flush_idle(void *data)
+{
+	log_flush_source = NULL;
+	log_flush();
+}
+
+/* Append one message to the ring as a single newline-terminated line */
+static void
+log_append(const char *msg, size_t len)
+{
+	if (len && msg[len - 1] == '\n')
+		len--;
+	if (len > LOG_RING_SIZE - 1)
+		len = LOG_RING_SIZE - 1;
+	if (log_ring_len + len + 1 > LOG_RING_SIZE)
+		log_flush();
+	memcpy(log_ring + log_ring_len, msg, len);
+	log_ring_len += len;
+	log_ring[log_ring_len++] = '\n';
+
+	if (!log_flush_source && event_loop)
+		log_flush_source = wl_event_loop_add_idle(event_loop, log_flush_idle, NULL);
+}
+
+/* Route an already formatted message to the log file and/or the REPL */
+void
+log_line(int level, const char *msg, size_t len)
+{
+	static int in_repl = 0;
+	char line[REPL_LINE_LEN];
+
+	if (level >= cfg_file_log_level)
+		log_append(msg, len);
+	if (level >= TBWM_LOG_ERROR) {
+		log_flush();
+		if (log_stderr_fd >= 0) {
+			ssize_t w = write(log_stderr_fd, msg, len);
+			if (w >= 0 && len && msg[len - 1] != '\n')
+				w = write(log_stderr_fd, "\n", 1);
+			(void)w;
+		}
+	}
+	/* Anything logged while drawing the REPL only goes to the file */
+	if (level >= cfg_repl_log_level && !in_repl) {
+		if (len && msg[len - 1] == '\n')
+			len--;
+		if (len > REPL_LINE_LEN - 1)
+			len = REPL_LINE_LEN - 1;
+		memcpy(line, msg, len);
+		line[len] = '\0';
+		in_repl = 1;
+		repl_add_line(line);
+		in_repl = 0;
+	}
+}
+
+static void
+tbwm_vlog(int level, int to_repl, const char *fmt, va_list ap)
 {
 	char buf[512];
+	int len;
+
+	/* Nothing is formatted unless someone is going to see it */
+	if (level < cfg_file_log_level && (!to_repl || level < cfg_repl_log_level))
+		return;
+	if ((len = vsnprintf(buf, sizeof(buf), fmt, ap)) < 0)
+		return;
+	if (len > (int)sizeof(buf) - 1)
+		len = sizeof(buf) - 1;
+	if (to_repl)
+		log_line(level, buf, len);
+	else
+		log_append(buf, len);
+}
+
+void
+tbwm_log(int level, const char *fmt, ...)
+{
 	va_list ap;
 	va_start(ap, fmt);
-	vsnprintf(buf, sizeof(buf), fmt, ap);
+	tbwm_vlog(level, 1, fmt, ap);
 	va_end(ap);
+}
 
-	/* Always write to debug file */
-	file_debug_log("%s", buf);
-
-	/* Also emit to stderr so external libraries still see the messages */
-	fprintf(stderr, "%s\n", buf);
+/* Debug-file-only message that never reaches the REPL */
+void
+file_debug_log(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	tbwm_vlog(TBWM_LOG_DEBUG, 0, fmt, ap);
+	va_end(ap);
+}
 
-	/* Send warnings/errors to REPL (trim to REPL_LINE_LEN-1)
-	 * Note: REPL only receives lines with level >= cfg_repl_log_level */
-	if (level >= cfg_repl_log_level) {
-		char line[REPL_LINE_LEN];
-		strncpy(line, buf, REPL_LINE_LEN - 1);
-		line[REPL_LINE_LEN - 1] = '\0';
-		repl_add_line(line);
-	}
+/* wlroots log callback: feed its messages into the same ring instead of
+ * letting them loop back through the stderr pipe */
+void
+wlr_log_cb(enum wlr_log_importance importance, const char *fmt, va_list args)
+{
+	int level = importance == WLR_ERROR ? TBWM_LOG_ERROR
+		: importance == WLR_INFO ? TBWM_LOG_INFO : TBWM_LOG_DEBUG;
+	tbwm_vlog(level, 1, fmt, args);
 }
 
 void
@@ -7016,532 +8370,862 @@ replkey(xkb_keysym_t sym)
 	return 1; /* Consume all keys in REPL mode */
 }
 
+/* Request a REPL redraw on every monitor; the work happens in rendermon() so
+ * a burst of log lines costs one update per output frame. */
 void
 updaterepl(void)
 {
-	struct TitleBuffer *tb;
+	Monitor *m;
+	wl_list_for_each(m, &mons, link) {
+		m->repl_dirty = 1;
+		if (m->wlr_output->enabled)
+			wlr_output_schedule_frame(m->wlr_output);
+	}
+}
+
+/* Force every REPL strip to be redrawn (colors or font changed) */
+void
+repl_invalidate(void)
+{
+	Monitor *m;
+	int i;
+	wl_list_for_each(m, &mons, link) {
+		for (i = 0; i < m->repl_rows; i++)
+			m->repl_strips[i].seq = 0;
+	}
+	updaterepl();
+}
+
+static void
+repl_free_strips(Monitor *m)
+{
+	int i;
+	for (i = 0; i < m->repl_rows; i++) {
+		wlr_scene_node_destroy(&m->repl_strips[i].node->node);
+		wlr_buffer_drop(&m->repl_strips[i].buf->base);
+	}
+	free(m->repl_strips);
+	m->repl_strips = NULL;
+	m->repl_rows = 0;
+}
+
+void
+destroyrepl(Monitor *m)
+{
+	repl_free_strips(m);
+	if (m->repl) {
+		wlr_scene_node_destroy(&m->repl->node);
+		m->repl = NULL;
+		m->repl_bg = NULL;
+		m->repl_more = NULL;
+	}
+	if (m->repl_more_buf) {
+		wlr_buffer_drop(&m->repl_more_buf->base);
+		m->repl_more_buf = NULL;
+	}
+}
+
+/* Draw the REPL for one monitor. Each visible history line lives in its own
+ * width x cell_height strip; strip (seq % rows) always holds line seq, so new
+ * output and scrolling only rasterize lines that were not on screen and just
+ * move the others. */
+void
+renderrepl(Monitor *m)
+{
+	int width = m->m.width, height = m->m.height;
+	int rows, i, k, x;
+	long hi, lo, seq;
 	uint32_t *pixels;
-	int width, height;
-	int x, y, i, line_idx;
-	int visible_lines;
 	const char *line;
-	
-	/* Render and attach REPL to every monitor */
-	if (!layers[LyrBg])
+	int idx, len;
+	ReplStrip *s;
+	float bg[4];
+
+	m->repl_dirty = 0;
+	if (!layers[LyrBg] || width <= 0 || height <= 0)
 		return;
 
-	Monitor *m;
-	wl_list_for_each(m, &mons, link) {
-		/* Hide per-monitor REPL if not visible */
-		if (!repl_visible) {
-			if (m->repl)
-				wlr_scene_node_set_enabled(&m->repl->node, 0);
-			continue;
+	if (!repl_visible) {
+		if (m->repl)
+			wlr_scene_node_set_enabled(&m->repl->node, 0);
+		return;
+	}
+
+	bg[0] = ((cfg_bg_color >> 16) & 0xFF) / 255.0f;
+	bg[1] = ((cfg_bg_color >> 8) & 0xFF) / 255.0f;
+	bg[2] = (cfg_bg_color & 0xFF) / 255.0f;
+	bg[3] = 1.0f;
+
+	if (!m->repl) {
+		m->repl = wlr_scene_tree_create(layers[LyrBg]);
+		m->repl_bg = wlr_scene_rect_create(m->repl, width, height, bg);
+		m->repl_more = wlr_scene_buffer_create(m->repl, NULL);
+	}
+	wlr_scene_node_set_enabled(&m->repl->node, 1);
+	wlr_scene_node_set_position(&m->repl->node, m->m.x, m->m.y);
+	wlr_scene_rect_set_size(m->repl_bg, width, height);
+	wlr_scene_rect_set_color(m->repl_bg, bg);
+
+	/* Rows available for history (leave space for bar at top) */
+	rows = (height - cell_height) / cell_height;
+	if (rows != m->repl_rows || width != m->repl_width || cell_height != m->repl_cell_h) {
+		repl_free_strips(m);
+		if (rows > 0) {
+			m->repl_strips = ecalloc(rows, sizeof(*m->repl_strips));
+			for (k = 0; k < rows; k++) {
+				m->repl_strips[k].buf = titlebuf_create(width, cell_height);
+				m->repl_strips[k].node = wlr_scene_buffer_create(m->repl, NULL);
+			}
+			m->repl_rows = rows;
 		}
+		m->repl_width = width;
+		m->repl_cell_h = cell_height;
+		wlr_scene_node_raise_to_top(&m->repl_more->node);
+	}
+
+	/* Visible seqs: hi is drawn on the bottom row, older lines stack upward */
+	hi = (long)repl_line_seq - repl_scroll_offset;
+	lo = (long)repl_line_seq - repl_history_count + 1;
+	if (lo < hi - rows + 1)
+		lo = hi - rows + 1;
 
-		width = m->m.width;
-		height = m->m.height;
-		if (width <= 0 || height <= 0)
+	for (k = 0; k < m->repl_rows; k++) {
+		s = &m->repl_strips[k];
+		/* The one seq in [lo, hi] that maps to this strip, if any */
+		seq = lo + ((k - lo % rows) % rows + rows) % rows;
+		if (seq > hi || seq < 1) {
+			wlr_scene_node_set_enabled(&s->node->node, 0);
 			continue;
+		}
 
-		/* Create buffer for this monitor's REPL background */
-		tb = ecalloc(1, sizeof(*tb));
-		tb->stride = width * 4;
-		tb->data = ecalloc(1, tb->stride * height);
-		titlebuf_alloc_count++; wlr_buffer_init(&tb->base, &titlebuf_impl, width, height);
-		pixels = tb->data;
+		if (s->seq != (unsigned long)seq) {
+			pixels = s->buf->data;
+			for (i = 0; i < width * cell_height; i++)
+				pixels[i] = RGB_TO_ARGB(cfg_bg_color);
+			idx = (repl_head + seq - ((long)repl_line_seq - repl_history_count + 1)) % repl_capacity;
+			line = repl_arena + (size_t)idx * REPL_LINE_LEN;
+			len = repl_line_len[idx];
+			for (i = 0, x = cell_width; i < len && x < width - cell_width; i++, x += cell_width)
+				draw_cell(pixels, width, cell_height, x, 0, (unsigned char)line[i],
+					RGB_TO_ARGB(cfg_bg_text_color), RGB_TO_ARGB(cfg_bg_color));
+			s->seq = seq;
+			wlr_scene_buffer_set_buffer(s->node, &s->buf->base);
+		}
+		ui_filter_set(s->node, m);
+		wlr_scene_node_set_position(&s->node->node, 0,
+			height - cell_height * 2 - (hi - seq) * cell_height);
+		wlr_scene_node_set_enabled(&s->node->node, 1);
+	}
+
+	/* Show scroll indicator if not at bottom */
+	if (repl_scroll_offset > 0) {
+		if (!m->repl_more_buf || m->repl_more_buf->base.width != cell_width
+				|| m->repl_more_buf->base.height != cell_height) {
+			if (m->repl_more_buf)
+				wlr_buffer_drop(&m->repl_more_buf->base);
+			m->repl_more_buf = titlebuf_create(cell_width, cell_height);
+		}
+		draw_cell(m->repl_more_buf->data, cell_width, cell_height, 0, 0,
+			0x25BC, RGB_TO_ARGB(cfg_bg_text_color), RGB_TO_ARGB(cfg_bg_color)); /* ▼ */
+		wlr_scene_buffer_set_buffer(m->repl_more, &m->repl_more_buf->base);
+		ui_filter_set(m->repl_more, m);
+		wlr_scene_node_set_position(&m->repl_more->node, width - cell_width * 3,
+			height - cell_height * 2);
+		wlr_scene_node_set_enabled(&m->repl_more->node, 1);
+	} else {
+		wlr_scene_node_set_enabled(&m->repl_more->node, 0);
+	}
+}
 
-		/* Fill with background color */
-		for (i = 0; i < width * height; i++)
-			pixels[i] = RGB_TO_ARGB(cfg_bg_color);
+static uint32_t
+hash_mix(uint32_t h, uint32_t v)
+{
+	return (h ^ v) * 16777619u;
+}
 
-		/* Calculate visible lines (leave space for bar at top) */
-		visible_lines = (height - cell_height) / cell_height;
+static void
+rgb_to_float(uint32_t rgb, float out[4])
+{
+	out[0] = ((rgb >> 16) & 0xFF) / 255.0f;
+	out[1] = ((rgb >> 8) & 0xFF) / 255.0f;
+	out[2] = (rgb & 0xFF) / 255.0f;
+	out[3] = 1.0f;
+}
 
-		/* Render history lines from bottom up */
-		y = height - cell_height * 2;  /* Start from bottom, leave space for bar */
+/* Put s at x in m's bar, w pixels wide. Returns scratch pixels to draw the
+ * whole segment into if key (plus font and width) differs from what s shows,
+ * NULL if s is already current. After drawing, barseg_done() copies in and
+ * damages the pixels that changed. */
+static uint32_t *
+barseg_place(Monitor *m, BarSeg *s, int x, int w, uint32_t key)
+{
+	if (w <= 0) {
+		barseg_hide(s);
+		return NULL;
+	}
+	key = hash_mix(hash_mix(key, font_serial), (uint32_t)w);
 
-		for (i = 0; i < visible_lines && i + repl_scroll_offset < repl_history_count; i++) {
-			line_idx = repl_history_count - 1 - i - repl_scroll_offset;
-			if (line_idx < 0)
-				break;
+	if (s->buf && (s->buf->base.width != w || s->buf->base.height != cell_height)) {
+		if (s->node)
+			wlr_scene_buffer_set_buffer(s->node, NULL);
+		titlebuf_recycle(s->buf);
+		s->buf = NULL;
+	}
+	if (!s->node)
+		s->node = wlr_scene_buffer_create(m->bar, NULL);
+	ui_filter_set(s->node, m);
+	wlr_scene_node_set_position(&s->node->node, x, 0);
+	wlr_scene_node_set_enabled(&s->node->node, 1);
+	s->x = x;
+	s->w = w;
 
-			line = repl_history[line_idx];
-			x = cell_width;
+	if (s->buf && s->key == key) {
+		bar_seg_skip_count++;
+		return NULL;
+	}
+	s->key = key;
+	bar_seg_draw_count++;
+	return draw_scratch(w, cell_height);
+}
 
-			/* Render the line */
-			while (*line && x < width - cell_width) {
-				render_char_to_buffer(pixels, width, height, x, y, (unsigned char)*line, RGB_TO_ARGB(cfg_bg_text_color));
-				x += cell_width;
-				line++;
-			}
+static void
+barseg_done(BarSeg *s)
+{
+	buffer_commit(s->node, &s->buf, s->w, cell_height);
+}
 
-			y -= cell_height;
-		}
+static void
+barseg_hide(BarSeg *s)
+{
+	if (s->node)
+		wlr_scene_node_set_enabled(&s->node->node, 0);
+}
 
-		/* Show scroll indicator if not at bottom */
-		if (repl_scroll_offset > 0) {
-			x = width - cell_width * 3;
-			render_char_to_buffer(pixels, width, height, x, height - cell_height * 2,
-				0x25BC, RGB_TO_ARGB(cfg_bg_text_color)); /* ▼ */
-		}
+static void
+barseg_fill(uint32_t *pixels, int w, uint32_t color)
+{
+	int i;
 
-		/* Create or update the per-monitor REPL buffer node */
-		if (!m->repl)
-			m->repl = wlr_scene_buffer_create(layers[LyrBg], NULL);
-		wlr_scene_node_set_enabled(&m->repl->node, 1);
-		wlr_scene_node_set_position(&m->repl->node, m->m.x, m->m.y);
-		wlr_scene_buffer_set_buffer(m->repl, &tb->base);
-		wlr_buffer_drop(&tb->base);
+	for (i = 0; i < w * cell_height; i++)
+		pixels[i] = color;
+}
+
+/* Draw the bytes of str from pixel x on; returns the x after them */
+static int
+barseg_text(uint32_t *pixels, int w, int x, const char *str, int len,
+            uint32_t fg, uint32_t bg)
+{
+	int i;
+
+	for (i = 0; i < len && x < w; i++) {
+		draw_cell(pixels, w, cell_height, x, 0, (unsigned char)str[i], fg, bg);
+		x += cell_width;
 	}
+	return x;
 }
 
 void
-updatebar(Monitor *m)
+destroybar(Monitor *m)
 {
-	struct TitleBuffer *tb;
-	uint32_t *pixels;
-	uint32_t bg, fg;
-	int width, i, x, tag, n, j;
-	int py, px, is_focused, title_max, title_len, date_len, time_len, right_x;
-	int len, fits, shown;
-	time_t now;
-	struct tm *tm_info;
-	char timebuf[32], datebuf[32];
-	const char *title, *prompt;
-	Client *c;
-	int max_tab_chars = 20;
-	int visible_count = 0;
-	int tab_area_width, tab_width_cells;
-
-	if (!m || !m->wlr_output || !m->wlr_output->enabled)
-		return;
-	
-	/* Don't update bar if scene isn't ready */
-	if (!layers[LyrOverlay])
-		return;
+	int i;
 
-	width = m->m.width;
-	if (width <= 0)
-		return;
+	/* Marquees live in the bar tree; drop them before it goes */
+	for (i = 0; i < MAX_TAB_MARQUEES; i++)
+		marquee_destroy(&m->tab_marquee[i]);
+	if (m->tab_marquee_overflow)
+		scrollref(m, -1);
+	m->tab_marquee_overflow = 0;
 
-	/* Check if width changed - need to reallocate buffer */
-	if (m->bar_buf && width != m->bar_width) {
-		if (m->bar)
-			wlr_scene_buffer_set_buffer(m->bar, NULL);
-		wlr_buffer_drop(&m->bar_buf->base);
-		m->bar_buf = NULL;
+	for (i = 0; i < SegLast; i++) {
+		if (m->bar_seg[i].buf)
+			wlr_buffer_drop(&m->bar_seg[i].buf->base);
+	}
+	for (i = 0; i < m->tab_seg_cap; i++) {
+		if (m->tab_segs[i].buf)
+			wlr_buffer_drop(&m->tab_segs[i].buf->base);
 	}
-	m->bar_width = width;
+	free(m->tab_segs);
+	m->tab_segs = NULL;
+	m->tab_seg_cap = 0;
+	memset(m->bar_seg, 0, sizeof(m->bar_seg));
+	m->clock_len = 0;
 
-	/* Reuse buffer if available, otherwise allocate new */
-	if (!m->bar_buf) {
-		m->bar_buf = ecalloc(1, sizeof(*m->bar_buf));
-		m->bar_buf->stride = width * 4;
-		m->bar_buf->data = ecalloc(1, m->bar_buf->stride * cell_height);
-		wlr_buffer_init(&m->bar_buf->base, &titlebuf_impl, width, cell_height);
-		titlebuf_alloc_count++;
+	if (m->bar) {
+		wlr_scene_node_destroy(&m->bar->node);
+		m->bar = NULL;
+		m->bar_bg = NULL;
 	}
-	tb = m->bar_buf;
-	pixels = tb->data;
+}
 
-	/* Fill background */
-	for (i = 0; i < width * cell_height; i++)
-		pixels[i] = RGB_TO_ARGB(cfg_bar_color);
+/* REPL input or launcher prompt, across the whole bar */
+static void
+renderbarline(Monitor *m, int width)
+{
+	BarSeg *s = &m->bar_seg[SegLine];
+	uint32_t fg = RGB_TO_ARGB(cfg_bar_text_color), bg = RGB_TO_ARGB(cfg_bar_color);
+	uint32_t sfg, sbg, key = 2166136261u, *pixels;
+	int x = 0, i, j, len, fits, shown;
 
-	x = 0;
+	key = hash_mix(key, repl_input_active);
+	key = hash_mix(key, fg);
+	key = hash_mix(key, bg);
+	if (repl_input_active) {
+		for (i = 0; i < repl_input_len; i++)
+			key = hash_mix(key, (unsigned char)repl_input[i]);
+	} else {
+		for (i = 0; i < launcher_input_len; i++)
+			key = hash_mix(key, (unsigned char)launcher_input[i]);
+		key = hash_mix(key, launcher_selection);
+		key = hash_mix(key, app_cache_count);
+	}
+	if (!(pixels = barseg_place(m, s, 0, width, key)))
+		return;
+	barseg_fill(pixels, width, bg);
 
 	if (repl_input_active) {
-		/* === REPL INPUT MODE === */
-		prompt = "Scheme> ";
-		for (i = 0; prompt[i] && x < width; i++) {
-			render_char_to_buffer(pixels, width, cell_height, x, 0, prompt[i], RGB_TO_ARGB(cfg_bar_text_color));
-			x += cell_width;
-		}
-		/* Input text */
-		for (i = 0; i < repl_input_len && x < width; i++) {
-			render_char_to_buffer(pixels, width, cell_height, x, 0, repl_input[i], RGB_TO_ARGB(cfg_bar_text_color));
-			x += cell_width;
-		}
+		x = barseg_text(pixels, width, x, "Scheme> ", 8, fg, bg);
+		x = barseg_text(pixels, width, x, repl_input, repl_input_len, fg, bg);
 		/* Cursor */
-		render_char_to_buffer(pixels, width, cell_height, x, 0, '_', RGB_TO_ARGB(cfg_bar_text_color));
-	} else if (launcher_active) {
-		/* === LAUNCHER MODE === */
-		prompt = "Launcher> ";
-		for (i = 0; prompt[i] && x < width; i++) {
-			render_char_to_buffer(pixels, width, cell_height, x, 0, prompt[i], RGB_TO_ARGB(cfg_bar_text_color));
-			x += cell_width;
-		}
-		/* Input text */
-		for (i = 0; i < launcher_input_len && x < width; i++) {
-			render_char_to_buffer(pixels, width, cell_height, x, 0, launcher_input[i], RGB_TO_ARGB(cfg_bar_text_color));
-			x += cell_width;
-		}
-		/* Separator */
-		x += cell_width;
-		render_char_to_buffer(pixels, width, cell_height, x, 0, '|', RGB_TO_ARGB(cfg_bar_text_color));
-		x += cell_width * 2;
+		draw_cell(pixels, width, cell_height, x, 0, '_', fg, bg);
+		barseg_done(s);
+		return;
+	}
 
-		/* Suggestions - only if there's input */
-		if (launcher_input_len > 0) {
-			shown = 0;
-			for (i = 0; i < app_cache_count && x < width - cell_width; i++) {
-				/* Prefix match */
-				if (strncmp(app_cache[i], launcher_input, launcher_input_len) == 0) {
-					len = strlen(app_cache[i]);
-					fits = (x + (len + 3) * cell_width) <= width;
-					if (!fits && shown > 0)
-						break;
+	x = barseg_text(pixels, width, x, "Launcher> ", 10, fg, bg);
+	x = barseg_text(pixels, width, x, launcher_input, launcher_input_len, fg, bg);
+	/* Separator */
+	x += cell_width;
+	draw_cell(pixels, width, cell_height, x, 0, '|', fg, bg);
+	x += cell_width * 2;
 
-					/* Highlight selected suggestion */
-					if (shown == launcher_selection) {
-						bg = RGB_TO_ARGB(cfg_bar_text_color);
-						fg = RGB_TO_ARGB(cfg_bar_color);
-						/* Draw background */
-						for (py = 0; py < cell_height; py++) {
-							for (px = x; px < x + (len + 2) * cell_width && px < width; px++) {
-								pixels[py * width + px] = bg;
-							}
-						}
-					} else {
-						fg = RGB_TO_ARGB(cfg_bar_text_color);
-					}
+	/* Suggestions - only if there's input */
+	if (launcher_input_len > 0) {
+		shown = 0;
+		for (i = 0; i < app_cache_count && x < width - cell_width; i++) {
+			/* Prefix match */
+			if (strncmp(app_cache[i], launcher_input, launcher_input_len) != 0)
+				continue;
+			len = strlen(app_cache[i]);
+			fits = (x + (len + 3) * cell_width) <= width;
+			if (!fits && shown > 0)
+				break;
 
-					render_char_to_buffer(pixels, width, cell_height, x, 0, '[', fg);
-					x += cell_width;
-					for (j = 0; app_cache[i][j] && x < width - cell_width * 2; j++) {
-						render_char_to_buffer(pixels, width, cell_height, x, 0, app_cache[i][j], fg);
-						x += cell_width;
-					}
-					render_char_to_buffer(pixels, width, cell_height, x, 0, ']', fg);
-					x += cell_width * 2;
-					shown++;
+			/* Highlight selected suggestion */
+			sfg = fg;
+			sbg = bg;
+			if (shown == launcher_selection) {
+				sbg = fg;
+				sfg = bg;
+				for (j = 0; j < cell_height; j++) {
+					int px;
+					for (px = x; px < x + (len + 2) * cell_width && px < width; px++)
+						pixels[j * width + px] = sbg;
 				}
 			}
-		}
-	} else {
-		/* === STATUS BAR MODE === */
-		/* App menu button [X] */
-		{
-			int btn_len = strlen(cfg_menu_button);
-			int btn_cells = btn_len + 2; /* [btn] */
-			if (appmenu_active) {
-				bg = RGB_TO_ARGB(cfg_bar_text_color);
-				fg = RGB_TO_ARGB(cfg_bar_color);
-				for (py = 0; py < cell_height; py++) {
-					for (px = x; px < x + btn_cells * cell_width && px < width; px++) {
-						pixels[py * width + px] = bg;
-					}
-				}
-			} else {
-				fg = RGB_TO_ARGB(cfg_bar_text_color);
-			}
-		}
-		render_char_to_buffer(pixels, width, cell_height, x, 0, '[', fg);
-		x += cell_width;
-		{
-			int bi;
-			for (bi = 0; cfg_menu_button[bi] && bi < 14; bi++) {
-				render_char_to_buffer(pixels, width, cell_height, x, 0, cfg_menu_button[bi], fg);
+
+			draw_cell(pixels, width, cell_height, x, 0, '[', sfg, sbg);
+			x += cell_width;
+			for (j = 0; app_cache[i][j] && x < width - cell_width * 2; j++) {
+				draw_cell(pixels, width, cell_height, x, 0, (unsigned char)app_cache[i][j], sfg, sbg);
 				x += cell_width;
 			}
+			draw_cell(pixels, width, cell_height, x, 0, ']', sfg, sbg);
+			x += cell_width * 2;
+			shown++;
 		}
-		render_char_to_buffer(pixels, width, cell_height, x, 0, ']', fg);
-		x += cell_width;
-		
-		/* Separator */
-		x += cell_width / 2;
-		render_char_to_buffer(pixels, width, cell_height, x, 0, '|', RGB_TO_ARGB(cfg_bar_text_color));
-		x += cell_width + cell_width / 2;
-
-		/* Tags [1] [2] [3] ... - use cfg_tagcount */
-		for (tag = 0; tag < cfg_tagcount; tag++) {
-			bg = RGB_TO_ARGB(cfg_bar_color);
-			fg = RGB_TO_ARGB(cfg_bar_text_color);
-
-			/* Highlight selected tag */
-			if (m->tagset[m->seltags] & (1 << tag)) {
-				bg = RGB_TO_ARGB(cfg_bar_text_color);
-				fg = RGB_TO_ARGB(cfg_bar_color);
+	}
+	barseg_done(s);
+}
+
+/* App menu button [X] at x; returns the x after it */
+static int
+renderbarmenu(Monitor *m, int x)
+{
+	BarSeg *s = &m->bar_seg[SegMenu];
+	int len = MIN((int)strlen(cfg_menu_button), 14);
+	int w = (len + 2) * cell_width;
+	uint32_t fg = RGB_TO_ARGB(appmenu_active ? cfg_bar_color : cfg_bar_text_color);
+	uint32_t bg = RGB_TO_ARGB(appmenu_active ? cfg_bar_text_color : cfg_bar_color);
+	uint32_t *pixels;
+
+	pixels = barseg_place(m, s, x, w,
+		hash_mix(hash_mix(frame_title_hash(cfg_menu_button), fg), bg));
+	if (pixels) {
+		draw_cell(pixels, w, cell_height, 0, 0, '[', fg, bg);
+		barseg_text(pixels, w, cell_width, cfg_menu_button, len, fg, bg);
+		draw_cell(pixels, w, cell_height, (len + 1) * cell_width, 0, ']', fg, bg);
+		barseg_done(s);
+	}
+	return x + w;
+}
+
+/* "| [1] [2] ... |" tag strip at x; returns the x after it */
+static int
+renderbartags(Monitor *m, int x)
+{
+	BarSeg *s = &m->bar_seg[SegTags];
+	uint32_t text = RGB_TO_ARGB(cfg_bar_text_color), bar = RGB_TO_ARGB(cfg_bar_color);
+	uint32_t fg, bg, key = 2166136261u, *pixels;
+	int w, tx, tag, py, px;
+
+	w = cell_width / 2 + cell_width + cell_width / 2
+		+ cfg_tagcount * (3 * cell_width + cell_width / 2)
+		+ cell_width / 2 + cell_width * 2;
+	key = hash_mix(key, m->tagset[m->seltags]);
+	key = hash_mix(key, cfg_tagcount);
+	key = hash_mix(key, text);
+	key = hash_mix(key, bar);
+	if (!(pixels = barseg_place(m, s, x, w, key)))
+		return x + w;
+	barseg_fill(pixels, w, bar);
+
+	/* Separator */
+	tx = cell_width / 2;
+	draw_cell(pixels, w, cell_height, tx, 0, '|', text, bar);
+	tx += cell_width + cell_width / 2;
+
+	for (tag = 0; tag < cfg_tagcount; tag++) {
+		fg = text;
+		bg = bar;
+		/* Highlight selected tag */
+		if (m->tagset[m->seltags] & (1 << tag)) {
+			fg = bar;
+			bg = text;
+			for (py = 0; py < cell_height; py++) {
+				for (px = tx; px < tx + 3 * cell_width && px < w; px++)
+					pixels[py * w + px] = bg;
 			}
+		}
+		draw_cell(pixels, w, cell_height, tx, 0, '[', fg, bg);
+		draw_cell(pixels, w, cell_height, tx + cell_width, 0, '1' + tag, fg, bg);
+		draw_cell(pixels, w, cell_height, tx + 2 * cell_width, 0, ']', fg, bg);
+		tx += 3 * cell_width + cell_width / 2; /* Small gap */
+	}
 
-			/* Draw tag background if highlighted */
-			if (bg != RGB_TO_ARGB(cfg_bar_color)) {
-				for (py = 0; py < cell_height; py++) {
-					for (px = x; px < x + 3 * cell_width && px < width; px++) {
-						pixels[py * width + px] = bg;
-					}
+	/* Separator */
+	tx += cell_width / 2;
+	draw_cell(pixels, w, cell_height, tx, 0, '|', text, bar);
+	barseg_done(s);
+	return x + w;
+}
+
+/* The nth tab segment, growing the array as needed */
+static BarSeg *
+bartabseg(Monitor *m, int n)
+{
+	BarSeg *tmp;
+	int newcap;
+
+	if (n < m->tab_seg_cap)
+		return &m->tab_segs[n];
+	newcap = m->tab_seg_cap ? m->tab_seg_cap * 2 : 16;
+	if (!(tmp = realloc(m->tab_segs, newcap * sizeof(*tmp)))) {
+		tbwm_log(TBWM_LOG_ERROR, "tbwm: out of memory growing bar tabs\n");
+		return NULL;
+	}
+	memset(tmp + m->tab_seg_cap, 0, (newcap - m->tab_seg_cap) * sizeof(*tmp));
+	m->tab_segs = tmp;
+	m->tab_seg_cap = newcap;
+	return &m->tab_segs[n];
+}
+
+/* One segment per visible window, from x on. Each tab is keyed by its own
+ * title and focus, so a title change redraws one tab. Returns the x after
+ * the last tab and the number of tab marquees used in *n_marquees. */
+static int
+renderbartabs(Monitor *m, int x, int width, int *n_marquees)
+{
+	unsigned long cps[256];
+	const char *title;
+	uint32_t fg, bg, key, *pixels;
+	int visible_count = 0, max_tab_chars = 20, reserved, tab_area_width, tab_width_cells;
+	int title_max, ncp, pos, shown, mode, w, view_w, n_tabs = 0, i;
+	BarSeg *s;
+	Client *c;
+
+	visible_count = m->nvisible;
+
+	/* Reserve space for: | date | time at the end */
+	reserved = 30 * cell_width;
+	tab_area_width = width - x - reserved;
+	if (tab_area_width < 0) tab_area_width = 0;
+
+	/* Shrink tab width if needed */
+	tab_width_cells = max_tab_chars + 2; /* +2 for brackets */
+	if (visible_count > 0 && visible_count * tab_width_cells * cell_width > tab_area_width) {
+		tab_width_cells = tab_area_width / (visible_count * cell_width);
+		if (tab_width_cells < 5) tab_width_cells = 5;
+	}
+	title_max = tab_width_cells - 2;
+
+	wl_list_for_each(c, &m->clients, mlink) {
+		if (!VISIBLEON(c, m))
+			continue;
+		if (x >= width - reserved || !(s = bartabseg(m, n_tabs)))
+			break;
+		n_tabs++;
+
+		title = client_get_title(c);
+		if (!title) title = "?";
+		ncp = pos = 0;
+		while (title[pos] && ncp < 255)
+			cps[ncp++] = utf8_decode(title, &pos);
+
+		fg = RGB_TO_ARGB(cfg_bar_text_color);
+		bg = RGB_TO_ARGB(cfg_bar_color);
+		if (c == focustop(m)) {
+			fg = RGB_TO_ARGB(cfg_bar_color);
+			bg = RGB_TO_ARGB(cfg_bar_text_color);
+		}
+
+		/* 0 = fits, 1 = truncated with "...", 2 = scrolling */
+		mode = ncp <= title_max - 1 ? 0 : title_scroll_mode ? 2 : title_max > 3 ? 1 : 0;
+		shown = MIN(ncp, title_max - 1);
+		w = (shown + 2) * cell_width;
+		view_w = MIN((title_max - 1) * cell_width, width - x - cell_width);
+
+		key = 2166136261u;
+		for (i = 0; i < ncp; i++)
+			key = hash_mix(key, (uint32_t)cps[i]);
+		key = hash_mix(key, fg);
+		key = hash_mix(key, bg);
+		key = hash_mix(key, mode);
+		key = hash_mix(key, title_max);
+		/* Out of marquees: this tab draws each step of the scroll itself */
+		if (mode == 2 && *n_marquees >= MAX_TAB_MARQUEES) {
+			if (!m->tab_marquee_overflow)
+				scrollref(m, 1);
+			m->tab_marquee_overflow = 1;
+			key = hash_mix(key, title_scroll_offset);
+		}
+
+		if ((pixels = barseg_place(m, s, x, w, key))) {
+			barseg_fill(pixels, w, bg);
+			draw_cell(pixels, w, cell_height, 0, 0, '[', fg, bg);
+			if (mode == 2 && *n_marquees >= MAX_TAB_MARQUEES) {
+				int loop = ncp + 2; /* +2 for "  " separator */
+				int offset = title_scroll_offset % (loop * cell_width);
+				for (i = 0; i < loop + title_max; i++)
+					draw_cell_clipped(pixels, w, cell_height,
+						cell_width + i * cell_width - offset, 0,
+						i % loop < ncp ? cps[i % loop] : ' ', fg, bg,
+						cell_width, cell_width + view_w);
+			} else if (mode != 2) {
+				for (i = 0; i < shown; i++) {
+					unsigned long cp = cps[i];
+					if (mode == 1 && i >= shown - 3)
+						cp = '.';
+					draw_cell(pixels, w, cell_height, (i + 1) * cell_width, 0, cp, fg, bg);
 				}
 			}
+			draw_cell(pixels, w, cell_height, (shown + 1) * cell_width, 0, ']', fg, bg);
+			barseg_done(s);
+		}
 
-			render_char_to_buffer(pixels, width, cell_height, x, 0, '[', fg);
-			x += cell_width;
-			render_char_to_buffer(pixels, width, cell_height, x, 0, '1' + tag, fg);
-			x += cell_width;
-			render_char_to_buffer(pixels, width, cell_height, x, 0, ']', fg);
-			x += cell_width;
-			x += cell_width / 2; /* Small gap */
+		/* Scrolled by scrolltick() moving the marquee's source box */
+		if (mode == 2 && *n_marquees < MAX_TAB_MARQUEES) {
+			marquee_update(&m->tab_marquee[*n_marquees], m, m->bar,
+				x + cell_width, 0, view_w, cps, ncp, fg, bg);
+			ui_filter_set(m->tab_marquee[(*n_marquees)++].node, m);
 		}
 
-		/* Separator */
-		x += cell_width / 2;
-		render_char_to_buffer(pixels, width, cell_height, x, 0, '|', RGB_TO_ARGB(cfg_bar_text_color));
-		x += cell_width * 2;
+		x += w;
+		x += cell_width / 2; /* Gap between tabs */
+	}
 
-		/* Window tabs */
-		visible_count = 0;
-		wl_list_for_each(c, &clients, link) {
-			if (VISIBLEON(c, m))
-				visible_count++;
-		}
-
-		if (visible_count > 0) {
-			/* Calculate how much space we have for tabs */
-			/* Reserve space for: | date | time at the end */
-			n = 30 * cell_width; /* reserved */
-			tab_area_width = width - x - n;
-			if (tab_area_width < 0) tab_area_width = 0;
-
-			/* Shrink tab width if needed */
-			tab_width_cells = max_tab_chars + 2; /* +2 for brackets */
-			if (visible_count * tab_width_cells * cell_width > tab_area_width) {
-				tab_width_cells = tab_area_width / (visible_count * cell_width);
-				if (tab_width_cells < 5) tab_width_cells = 5;
-			}
+	for (i = n_tabs; i < m->tab_seg_cap; i++)
+		barseg_hide(&m->tab_segs[i]);
+	return x;
+}
 
-			wl_list_for_each(c, &clients, link) {
-				if (!VISIBLEON(c, m))
-					continue;
-				if (x >= width - n)
-					break;
+/* Custom status text, right-aligned if it fits after x */
+static void
+renderbarstatus(Monitor *m, int x, int width)
+{
+	BarSeg *s = &m->bar_seg[SegStatus];
+	uint32_t fg = RGB_TO_ARGB(cfg_bar_text_color), bg = RGB_TO_ARGB(cfg_bar_color);
+	uint32_t *pixels;
+	int len = strlen(cfg_status_text);
+	int w = (len + 3) * cell_width;
 
-				title = client_get_title(c);
-				if (!title) title = "?";
+	if (!len || width - w <= x) {
+		barseg_hide(s);
+		return;
+	}
+	pixels = barseg_place(m, s, width - w, w,
+		hash_mix(hash_mix(frame_title_hash(cfg_status_text), fg), bg));
+	if (pixels) {
+		barseg_fill(pixels, w, bg);
+		draw_cell(pixels, w, cell_height, 0, 0, '|', fg, bg);
+		barseg_text(pixels, w, cell_width * 2, cfg_status_text, len, fg, bg);
+		barseg_done(s);
+	}
+}
 
-				is_focused = (c == focustop(m));
-				bg = RGB_TO_ARGB(cfg_bar_color);
-				fg = RGB_TO_ARGB(cfg_bar_text_color);
+/* The bar is a tree: a background rect plus independently cached segments
+ * (menu button, tag strip, one per tab, status text, clock, or the
+ * launcher/REPL line). A redraw only rasterizes segments whose content
+ * changed, so e.g. a tag switch redraws the tag strip and the tabs that
+ * came and went. */
+void
+renderbar(Monitor *m)
+{
+	int width, x, i, len;
+	int n_marquees = 0;
+	char clockbuf[80];
+	float bg[4];
+	Client *fc;
 
-				if (is_focused) {
-					bg = RGB_TO_ARGB(cfg_bar_text_color);
-					fg = RGB_TO_ARGB(cfg_bar_color);
-				}
+	if (!m || !m->wlr_output || !m->wlr_output->enabled)
+		return;
+	
+	/* Don't update bar if scene isn't ready */
+	if (!layers[LyrOverlay])
+		return;
 
-				title_max = tab_width_cells - 2;
-				title_len = strlen(title);
-				
-				/* Calculate actual tab width for background */
-				int actual_title_chars = (title_len < title_max - 1) ? title_len : title_max - 1;
-				int actual_tab_width = (actual_title_chars + 2) * cell_width; /* +2 for brackets */
-				
-				/* Draw background for focused */
-				if (is_focused) {
-					for (py = 0; py < cell_height; py++) {
-						for (px = x; px < x + actual_tab_width && px < width; px++) {
-							pixels[py * width + px] = bg;
-						}
-					}
-				}
+	width = m->m.width;
+	if (width <= 0)
+		return;
 
-				render_char_to_buffer(pixels, width, cell_height, x, 0, '[', fg);
-				x += cell_width;
-				
-				if (title_len > title_max - 1 && title_scroll_mode) {
-					/* Smooth pixel-based scrolling for top bar tabs */
-					/* First decode title to codepoints */
-					unsigned long title_cps[256];
-					int title_cp_count = 0, utf8_pos = 0;
-					while (title[utf8_pos] && title_cp_count < 255) {
-						title_cps[title_cp_count++] = utf8_decode(title, &utf8_pos);
-					}
-					
-					int scroll_chars = title_cp_count + 2; /* +2 for "  " separator */
-					int total_scroll_width = scroll_chars * cell_width;
-					int pixel_offset = title_scroll_offset % total_scroll_width;
-					int display_width = (title_max - 1) * cell_width;
-					int text_start_x = x;
-					int text_end_x = x + display_width;
-					int char_idx;
-					
-					any_title_needs_scroll = 1;
-					
-					for (char_idx = 0; char_idx < scroll_chars + title_max; char_idx++) {
-						int src_char = char_idx % scroll_chars;
-						int draw_x = text_start_x + char_idx * cell_width - pixel_offset;
-						unsigned long cp;
-						
-						cp = (src_char < title_cp_count) ? title_cps[src_char] : ' ';
-						render_char_clipped(pixels, width, cell_height, draw_x, 0, cp, fg, text_start_x, text_end_x);
-					}
-					x += display_width;
-				} else if (title_len > title_max - 1 && title_max > 3) {
-					/* Truncation mode with ellipsis */
-					int utf8_pos = 0, char_count = 0;
-					while (title[utf8_pos] && char_count < title_max - 4 && x < width - cell_width) {
-						unsigned long cp = utf8_decode(title, &utf8_pos);
-						render_char_to_buffer(pixels, width, cell_height, x, 0, cp, fg);
-						x += cell_width;
-						char_count++;
-					}
-					render_char_to_buffer(pixels, width, cell_height, x, 0, '.', fg);
-					x += cell_width;
-					render_char_to_buffer(pixels, width, cell_height, x, 0, '.', fg);
-					x += cell_width;
-					render_char_to_buffer(pixels, width, cell_height, x, 0, '.', fg);
-					x += cell_width;
-				} else {
-					/* Title fits */
-					int utf8_pos = 0, char_count = 0;
-					while (title[utf8_pos] && char_count < title_max - 1 && x < width - cell_width) {
-						unsigned long cp = utf8_decode(title, &utf8_pos);
-						render_char_to_buffer(pixels, width, cell_height, x, 0, cp, fg);
-						x += cell_width;
-						char_count++;
-					}
-				}
+	rgb_to_float(cfg_bar_color, bg);
+	if (!m->bar) {
+		m->bar = wlr_scene_tree_create(layers[LyrTop]);
+		m->bar_bg = wlr_scene_rect_create(m->bar, width, cell_height, bg);
+	}
+	wlr_scene_node_set_position(&m->bar->node, m->m.x, m->m.y);
+	wlr_scene_rect_set_size(m->bar_bg, width, cell_height);
+	wlr_scene_rect_set_color(m->bar_bg, bg);
+
+	m->clock_len = 0;
+	if (m->tab_marquee_overflow)
+		scrollref(m, -1);
+	m->tab_marquee_overflow = 0;
+
+	if (repl_input_active || launcher_active) {
+		renderbarline(m, width);
+		barseg_hide(&m->bar_seg[SegMenu]);
+		barseg_hide(&m->bar_seg[SegTags]);
+		barseg_hide(&m->bar_seg[SegStatus]);
+		for (i = 0; i < m->tab_seg_cap; i++)
+			barseg_hide(&m->tab_segs[i]);
+	} else {
+		barseg_hide(&m->bar_seg[SegLine]);
+		x = renderbarmenu(m, 0);
+		x = renderbartags(m, x);
+		x = renderbartabs(m, x, width, &n_marquees);
 
-				render_char_to_buffer(pixels, width, cell_height, x, 0, ']', fg);
-				x += cell_width;
-				x += cell_width / 2; /* Gap between tabs */
-			}
+		/* Right-align status: custom text OR date/time */
+		renderbarstatus(m, x, width);
+		if (!cfg_status_text[0] && (len = clock_format(clockbuf, sizeof(clockbuf))) > 0
+				&& width - len * cell_width > x) {
+			/* Placed here, drawn by renderclock() when its text changes */
+			m->clock_len = len;
+			m->bar_seg[SegClock].x = width - len * cell_width;
 		}
+	}
 
-		/* Right-align status: custom text OR date/time */
-		now = time(NULL);
-		tm_info = localtime(&now);
-		
-		/* Check if custom status text is set */
-		if (cfg_status_text[0] != '\0') {
-			/* Custom status text mode */
-			int status_len = strlen(cfg_status_text);
-			right_x = width - (status_len + 3) * cell_width;
-			
-			if (right_x > x) {
-				x = right_x;
-				render_char_to_buffer(pixels, width, cell_height, x, 0, '|', RGB_TO_ARGB(cfg_bar_text_color));
-				x += cell_width * 2;
-				for (i = 0; cfg_status_text[i]; i++) {
-					render_char_to_buffer(pixels, width, cell_height, x, 0, (unsigned char)cfg_status_text[i], RGB_TO_ARGB(cfg_bar_text_color));
-					x += cell_width;
-				}
-			}
-		} else if (cfg_show_date || cfg_show_time) {
-			/* Date/time mode */
-			strftime(datebuf, sizeof(datebuf), "%Y-%m-%d", tm_info);
-			strftime(timebuf, sizeof(timebuf), "%I:%M:%S %p", tm_info);
+	/* Hide bar when a fullscreen client is focused */
+	fc = focustop(m);
+	wlr_scene_node_set_enabled(&m->bar->node, !(fc && fc->isfullscreen));
+	if (fc && fc->isfullscreen)
+		n_marquees = 0;
+	for (i = n_marquees; i < MAX_TAB_MARQUEES; i++)
+		marquee_hide(&m->tab_marquee[i]);
+	renderclock(m);
+}
 
-			date_len = cfg_show_date ? strlen(datebuf) : 0;
-			time_len = cfg_show_time ? strlen(timebuf) : 0;
-			
-			/* Calculate right-aligned position */
-			int total_chars = 0;
-			if (cfg_show_date && cfg_show_time) {
-				total_chars = date_len + time_len + 5; /* | date | time */
-			} else if (cfg_show_date) {
-				total_chars = date_len + 3; /* | date */
-			} else if (cfg_show_time) {
-				total_chars = time_len + 3; /* | time */
-			}
-			right_x = width - total_chars * cell_width;
+/* Format the bar's date/time segment ("| date | time", padded like the
+ * rest of the bar) into buf. Returns its length in cells, 0 if the bar
+ * shows no clock. */
+int
+clock_format(char *buf, size_t size)
+{
+	char datebuf[32], timebuf[32];
+	time_t now;
+	struct tm *tm_info;
+	int len;
 
-			if (right_x > x) {
-				x = right_x;
-				render_char_to_buffer(pixels, width, cell_height, x, 0, '|', RGB_TO_ARGB(cfg_bar_text_color));
-				x += cell_width * 2;
-				
-				if (cfg_show_date) {
-					for (i = 0; datebuf[i]; i++) {
-						render_char_to_buffer(pixels, width, cell_height, x, 0, datebuf[i], RGB_TO_ARGB(cfg_bar_text_color));
-						x += cell_width;
-					}
-					if (cfg_show_time) {
-						x += cell_width;
-						render_char_to_buffer(pixels, width, cell_height, x, 0, '|', RGB_TO_ARGB(cfg_bar_text_color));
-						x += cell_width * 2;
-					}
-				}
-				
-				if (cfg_show_time) {
-					for (i = 0; timebuf[i]; i++) {
-						render_char_to_buffer(pixels, width, cell_height, x, 0, timebuf[i], RGB_TO_ARGB(cfg_bar_text_color));
-						x += cell_width;
-					}
-				}
+	if (cfg_status_text[0] || (!cfg_show_date && !cfg_show_time))
+		return 0;
+
+	now = time(NULL);
+	tm_info = localtime(&now);
+	strftime(datebuf, sizeof(datebuf), "%Y-%m-%d", tm_info);
+	strftime(timebuf, sizeof(timebuf), "%I:%M:%S %p", tm_info);
+
+	if (cfg_show_date && cfg_show_time)
+		len = snprintf(buf, size, "| %s | %s", datebuf, timebuf);
+	else if (cfg_show_date)
+		len = snprintf(buf, size, "| %s ", datebuf);
+	else
+		len = snprintf(buf, size, "| %s ", timebuf);
+	return len < 0 ? 0 : MIN(len, (int)size - 1);
+}
+
+/* Draw the clock segment renderbar() placed. A tick that doesn't change the
+ * text (or a bar redraw that doesn't change the clock) costs one strftime. */
+void
+renderclock(Monitor *m)
+{
+	BarSeg *s = &m->bar_seg[SegClock];
+	char text[80];
+	uint32_t fg, bg, key = 2166136261u, *pixels;
+	int len, w, i;
+
+	if (!m->bar)
+		return;
+	if (!m->clock_len) {
+		barseg_hide(s);
+		return;
+	}
+
+	len = clock_format(text, sizeof(text));
+	if (len != m->clock_len) {
+		/* Config changed the layout; the whole bar has to be redone */
+		updatebar(m);
+		return;
+	}
+
+	fg = RGB_TO_ARGB(cfg_bar_text_color);
+	bg = RGB_TO_ARGB(cfg_bar_color);
+	for (i = 0; i < len; i++)
+		key = hash_mix(key, (unsigned char)text[i]);
+	key = hash_mix(hash_mix(key, fg), bg);
+
+	w = len * cell_width;
+	if ((pixels = barseg_place(m, s, s->x, w, key))) {
+		barseg_text(pixels, w, 0, text, len, fg, bg);
+		barseg_done(s);
+	}
+}
+
+/* Directions in which `other` shares an edge with c (NEIGHBOR_* bits).
+ * Windows overlap by 1 cell when tiled, so we check if our top row
+ * is covered by another window's bottom row, etc. */
+static int
+neighbor_bits(const Client *c, const Client *other)
+{
+	int h_overlap, v_overlap, bits = 0;
+
+	/* Check horizontal overlap for vertical neighbors */
+	h_overlap = (other->geom.x < c->geom.x + c->geom.width &&
+	             other->geom.x + other->geom.width > c->geom.x);
+	/* Check vertical overlap for horizontal neighbors */
+	v_overlap = (other->geom.y < c->geom.y + c->geom.height &&
+	             other->geom.y + other->geom.height > c->geom.y);
+
+	/* above: other's bottom row overlaps our top row */
+	if (h_overlap && other->geom.y < c->geom.y &&
+	    other->geom.y + other->geom.height > c->geom.y)
+		bits |= NEIGHBOR_ABOVE;
+	/* below: other's top row overlaps our bottom row */
+	if (h_overlap && other->geom.y < c->geom.y + c->geom.height &&
+	    other->geom.y + other->geom.height > c->geom.y + c->geom.height)
+		bits |= NEIGHBOR_BELOW;
+	/* left: other overlaps our left column */
+	if (v_overlap && other->geom.x < c->geom.x &&
+	    other->geom.x + other->geom.width > c->geom.x)
+		bits |= NEIGHBOR_LEFT;
+	/* right: other overlaps our right column */
+	if (v_overlap && other->geom.x < c->geom.x + c->geom.width &&
+	    other->geom.x + other->geom.width > c->geom.x + c->geom.width)
+		bits |= NEIGHBOR_RIGHT;
+	return bits;
+}
+
+/* Test c against the windows of v (sorted by left or top edge) whose left
+ * (top) edge lies in c's last column (row), where a tiled neighbor's
+ * shared border sits. Two binary searches bound them. */
+static void
+neighbor_sweep(Client *const *v, int n, int vertical, Client *c)
+{
+	int edge, j, end;
+
+	edge = vertical ? c->geom.y + c->geom.height : c->geom.x + c->geom.width;
+	j = tileindex_lower(v, n, vertical, edge - (vertical ? cell_height : cell_width));
+	end = tileindex_lower(v, n, vertical, edge);
+	for (; j < end; j++) {
+		if (v[j] == c)
+			continue;
+		c->neighbors |= neighbor_bits(c, v[j]);
+		v[j]->neighbors |= neighbor_bits(v[j], c);
+	}
+}
+
+/* Rebuild m->tiled and the neighbor masks of m's clients after a layout
+ * pass. Every relation needs the two windows to overlap, and tiled
+ * windows only overlap in the one-cell border they share, so each pair
+ * has one window's left (top) edge in the other's last column (row):
+ * matching right edges against left edges in by_x and bottom edges
+ * against top edges in by_y finds them all in O(n log n), a stack column
+ * included. Windows overlapping by more than a cell (monocle) are not
+ * neighbors. Clients whose mask changed get their frame redrawn (corner
+ * glyphs). */
+void
+updateneighbors(Monitor *m)
+{
+	static int *mask = NULL;
+	static int mask_cap = 0;
+	TileIndex *ix = &m->tiled;
+	Client *c;
+	int i;
+
+	ix->n = 0;
+	wl_list_for_each(c, &m->clients, mlink) {
+		/* Floating windows never have neighbors (always draw full border) */
+		if (!VISIBLEON(c, m) || c->isfloating || c->isfullscreen) {
+			if (c->neighbors) {
+				c->neighbors = 0;
+				updateframe(c);
 			}
+			continue;
+		}
+		if (!tileindex_reserve(ix, ix->n + 1)) {
+			tbwm_log(TBWM_LOG_ERROR, "tbwm: out of memory growing neighbor index\n");
+			ix->n = 0;
+			return;
+		}
+		ix->by_x[ix->n++] = c;
+	}
+	if (ix->n > mask_cap) {
+		int *mk = realloc(mask, ix->cap * sizeof(*mask));
+		if (!mk) {
+			tbwm_log(TBWM_LOG_ERROR, "tbwm: out of memory growing neighbor index\n");
+			ix->n = 0;
+			return;
 		}
+		mask = mk;
+		mask_cap = ix->cap;
 	}
 
-	/* Set the bar buffer */
-	if (!m->bar)
-		m->bar = wlr_scene_buffer_create(layers[LyrTop], NULL);
-	wlr_scene_node_set_position(&m->bar->node, m->m.x, m->m.y);
-	wlr_scene_buffer_set_buffer(m->bar, &tb->base);
-	/* Don't drop - we're caching the buffer for reuse */
+	tileindex_sort(ix);
+	/* Keep the old masks; only frames whose mask changes are redrawn */
+	for (i = 0; i < ix->n; i++) {
+		mask[i] = ix->by_x[i]->neighbors;
+		ix->by_x[i]->neighbors = 0;
+	}
+	for (i = 0; i < ix->n; i++) {
+		neighbor_sweep(ix->by_x, ix->n, 0, ix->by_x[i]);
+		neighbor_sweep(ix->by_y, ix->n, 1, ix->by_y[i]);
+	}
 
-	/* Hide bar when a fullscreen client is focused */
-	Client *fc = focustop(m);
-	wlr_scene_node_set_enabled(&m->bar->node, !(fc && fc->isfullscreen));
+	for (i = 0; i < ix->n; i++) {
+		if (ix->by_x[i]->neighbors != mask[i])
+			updateframe(ix->by_x[i]);
+	}
 }
 
-/* Check if there's an adjacent tiled window in the given direction.
- * Windows overlap by 1 cell when tiled, so we check if our top row
- * is covered by another window's bottom row, etc. */
-static int
-has_neighbor(Client *c, int dir) /* 0=above, 1=below, 2=left, 3=right */
+/* FNV-1a over the title bytes, used for the frame state fingerprint */
+static uint32_t
+frame_title_hash(const char *title)
 {
-	Client *other;
-	int h_overlap, v_overlap;
+	uint32_t h = 2166136261u;
 
-	if (!c || !c->mon)
-		return 0;
-	
-	/* Floating windows never have neighbors (always draw full border) */
-	if (c->isfloating)
-		return 0;
-	
-	wl_list_for_each(other, &clients, link) {
-		if (other == c || other->mon != c->mon)
-			continue;
-		if (!VISIBLEON(other, c->mon) || other->isfloating || other->isfullscreen)
-			continue;
-		
-		/* Check horizontal overlap for vertical neighbors */
-		h_overlap = (other->geom.x < c->geom.x + c->geom.width &&
-		             other->geom.x + other->geom.width > c->geom.x);
-		/* Check vertical overlap for horizontal neighbors */
-		v_overlap = (other->geom.y < c->geom.y + c->geom.height &&
-		             other->geom.y + other->geom.height > c->geom.y);
-		
-		switch (dir) {
-		case 0: /* above: other overlaps our top row */
-			/* other's bottom row overlaps our top row */
-			if (h_overlap &&
-			    other->geom.y < c->geom.y &&
-			    other->geom.y + other->geom.height > c->geom.y)
-				return 1;
-			break;
-		case 1: /* below: other overlaps our bottom row */
-			/* other's top row overlaps our bottom row */
-			if (h_overlap &&
-			    other->geom.y < c->geom.y + c->geom.height &&
-			    other->geom.y + other->geom.height > c->geom.y + c->geom.height)
-				return 1;
-			break;
-		case 2: /* left: other overlaps our left column */
-			if (v_overlap &&
-			    other->geom.x < c->geom.x &&
-			    other->geom.x + other->geom.width > c->geom.x)
-				return 1;
-			break;
-		case 3: /* right: other overlaps our right column */
-			if (v_overlap &&
-			    other->geom.x < c->geom.x + c->geom.width &&
-			    other->geom.x + other->geom.width > c->geom.x + c->geom.width)
-				return 1;
-			break;
-		}
+	while (*title) {
+		h ^= (unsigned char)*title++;
+		h *= 16777619u;
 	}
-	return 0;
+	return h;
 }
 
 /* Decode one UTF-8 character, return codepoint and advance *pos */
@@ -7694,68 +9378,541 @@ render_char_to_buffer(uint32_t *pixels, int buf_w, int buf_h, int x, int y,
 	}
 }
 
-/* Render character with horizontal clipping bounds */
+/* Drop all cell tiles; called when colors or the font change */
 void
-render_char_clipped(uint32_t *pixels, int buf_w, int buf_h, int x, int y,
-                    unsigned long charcode, uint32_t color, int clip_left, int clip_right)
+tile_cache_invalidate(void)
 {
-	CachedGlyph *cg;
-	int gx, gy, px, py;
-	unsigned char v, r, g, b;
+	int i;
+	for (i = 0; i < TILE_CACHE_SIZE; i++)
+		tile_cache[i].valid = 0;
+}
+
+/* Get the composited tile for a cell, rasterizing it on a miss */
+static const uint32_t *
+get_cell_tile(unsigned long charcode, uint32_t fg, uint32_t bg)
+{
+	uint32_t h = (uint32_t)charcode * 2654435761u ^ fg * 40503u ^ bg * 2246822519u;
+	int start = h % TILE_CACHE_SIZE;
+	int idx, i, slot = -1;
+	int tile_size;
+	uint32_t *tile;
+
+	/* (Re)allocate the tile arena when the cell size changes */
+	if (!tile_pixels || tile_w != cell_width || tile_h != cell_height) {
+		free(tile_pixels);
+		tile_pixels = calloc((size_t)TILE_CACHE_SIZE * cell_width * cell_height, sizeof(uint32_t));
+		if (!tile_pixels)
+			return NULL;
+		tile_w = cell_width;
+		tile_h = cell_height;
+		tile_cache_invalidate();
+	}
+	tile_size = tile_w * tile_h;
+
+	for (i = 0; i < TILE_CACHE_PROBE; i++) {
+		idx = (start + i) % TILE_CACHE_SIZE;
+		if (!tile_cache[idx].valid) {
+			if (slot < 0)
+				slot = idx;
+		} else if (tile_cache[idx].charcode == charcode
+				&& tile_cache[idx].fg == fg && tile_cache[idx].bg == bg) {
+			tile_hit_count++;
+			return tile_pixels + (size_t)idx * tile_size;
+		}
+	}
+
+	/* Miss: use a free slot in the probe window or evict the home slot */
+	tile_miss_count++;
+	if (slot < 0)
+		slot = start;
+	tile = tile_pixels + (size_t)slot * tile_size;
+	for (i = 0; i < tile_size; i++)
+		tile[i] = bg;
+
+	render_char_to_buffer(tile, tile_w, tile_h, 0, 0, charcode, fg);
+
+	tile_cache[slot].charcode = charcode;
+	tile_cache[slot].fg = fg;
+	tile_cache[slot].bg = bg;
+	tile_cache[slot].valid = 1;
+	return tile;
+}
+
+/* Draw a whole cell (glyph and background) with horizontal clipping bounds */
+void
+draw_cell_clipped(uint32_t *pixels, int buf_w, int buf_h, int x, int y,
+                  unsigned long charcode, uint32_t fg, uint32_t bg, int clip_left, int clip_right)
+{
+	const uint32_t *tile;
+	int x0 = MAX(x, MAX(clip_left, 0));
+	int x1 = MIN(x + cell_width, MIN(clip_right, buf_w));
+	int y0 = MAX(y, 0);
+	int y1 = MIN(y + cell_height, buf_h);
+	int row;
+
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	if (!(tile = get_cell_tile(charcode, fg, bg)))
+		return;
+	for (row = y0; row < y1; row++)
+		memcpy(pixels + (size_t)row * buf_w + x0,
+			tile + (row - y) * cell_width + (x0 - x),
+			(x1 - x0) * sizeof(uint32_t));
+}
 
-	cg = get_cached_glyph(charcode);
-	if (!cg || !cg->bitmap)
+void
+draw_cell(uint32_t *pixels, int buf_w, int buf_h, int x, int y,
+          unsigned long charcode, uint32_t fg, uint32_t bg)
+{
+	draw_cell_clipped(pixels, buf_w, buf_h, x, y, charcode, fg, bg, 0, buf_w);
+}
+
+uint32_t *
+draw_scratch(int w, int h)
+{
+	size_t n = (size_t)w * h;
+
+	if (n > draw_scratch_cap) {
+		free(draw_scratch_px);
+		draw_scratch_px = ecalloc(n, sizeof(*draw_scratch_px));
+		draw_scratch_cap = n;
+	}
+	return draw_scratch_px;
+}
+
+/* Show what was drawn into draw_scratch() (w x h) in node, keeping the
+ * buffer in *slot. The shown buffer may still be read by the renderer, so a
+ * change is written into an unlocked buffer from the pool and swapped in,
+ * damaging only the box of pixels that differ, and the old buffer is
+ * recycled. A rewrite that changes no pixel does nothing. */
+void
+buffer_commit(struct wlr_scene_buffer *node, struct TitleBuffer **slot, int w, int h)
+{
+	struct TitleBuffer *old = *slot, *tb;
+	int x1 = 0, y1 = 0, x2 = w, y2 = h, y, l, r;
+	const uint32_t *src, *dst;
+	pixman_region32_t damage;
+
+	if (old && old->base.width == w && old->base.height == h
+			&& node->buffer == &old->base) {
+		x1 = w;
+		y1 = h;
+		x2 = y2 = 0;
+		for (y = 0; y < h; y++) {
+			src = draw_scratch_px + (size_t)y * w;
+			dst = (const uint32_t *)((char *)old->data + (size_t)y * old->stride);
+			if (!memcmp(dst, src, w * sizeof(*dst)))
+				continue;
+			for (l = 0; dst[l] == src[l]; l++);
+			for (r = w; dst[r - 1] == src[r - 1]; r--);
+			x1 = MIN(x1, l);
+			x2 = MAX(x2, r);
+			y1 = MIN(y1, y);
+			y2 = y + 1;
+		}
+		if (x1 >= x2) {
+			damage_clean_count++;
+			return;
+		}
+	}
+
+	tb = titlebuf_acquire(w, h);
+	memcpy(tb->data, draw_scratch_px, (size_t)w * h * sizeof(*draw_scratch_px));
+	pixman_region32_init_rect(&damage, x1, y1, x2 - x1, y2 - y1);
+	wlr_scene_buffer_set_buffer_with_damage(node, &tb->base, &damage);
+	pixman_region32_fini(&damage);
+	damage_px_total += (unsigned long)(x2 - x1) * (y2 - y1);
+
+	if (old)
+		titlebuf_recycle(old);
+	*slot = tb;
+}
+
+/* Count a shown marquee against output m, moving the count over if it was
+ * counted against another one. */
+void
+marquee_count(Marquee *mq, Monitor *m)
+{
+	Monitor *was = mq->shown ? mq->mon : NULL;
+
+	if (mq->shown && was == m)
 		return;
+	/* Add before removing so the total never passes through zero */
+	scrollref(m, 1);
+	if (mq->shown)
+		scrollref(was, -1);
+	mq->shown = 1;
+	mq->mon = m;
+}
 
-	r = (color >> 16) & 0xFF;
-	g = (color >> 8) & 0xFF;
-	b = color & 0xFF;
+/* Show cps (looping with a 2-space gap) in a view_w wide marquee at x,y in
+ * parent on output m. The strip is only re-rasterized when its text, colors
+ * or font change. */
+void
+marquee_update(Marquee *mq, Monitor *m, struct wlr_scene_tree *parent,
+               int x, int y, int view_w, const unsigned long *cps, int ncp, uint32_t fg, uint32_t bg)
+{
+	int loop_chars = ncp + 2;
+	int strip_w, i;
+	uint32_t key = 2166136261u;
 
-	for (gy = 0; gy < cg->rows; gy++) {
-		py = y + (cell_height - cg->bitmap_top) + gy - 4;
-		if (py < 0 || py >= buf_h) continue;
-		for (gx = 0; gx < cg->width; gx++) {
-			px = x + cg->bitmap_left + gx;
-			if (px < clip_left || px >= clip_right) continue;
-			if (px < 0 || px >= buf_w) continue;
-			v = cg->bitmap[gy * cg->pitch + gx];
-			if (v > 0)
-				pixels[py * buf_w + px] = 0xFF000000 |
-					((r * v / 255) << 16) |
-					((g * v / 255) << 8) |
-					(b * v / 255);
+	if (view_w <= 0 || ncp <= 0) {
+		marquee_hide(mq);
+		return;
+	}
+
+	for (i = 0; i < ncp; i++)
+		key = hash_mix(key, (uint32_t)cps[i]);
+	key = hash_mix(key, fg);
+	key = hash_mix(key, bg);
+	key = hash_mix(key, font_serial);
+	key = hash_mix(key, (uint32_t)view_w);
+
+	if (!mq->node)
+		mq->node = wlr_scene_buffer_create(parent, NULL);
+
+	if (!mq->buf || mq->key != key) {
+		/* One loop plus a view width so any offset in [0, loop_w) fits */
+		mq->loop_w = loop_chars * cell_width;
+		mq->view_w = view_w;
+		strip_w = mq->loop_w + ((view_w + cell_width - 1) / cell_width) * cell_width;
+		if (mq->buf)
+			wlr_buffer_drop(&mq->buf->base);
+		mq->buf = titlebuf_create(strip_w, cell_height);
+		for (i = 0; i * cell_width < strip_w; i++)
+			draw_cell(mq->buf->data, strip_w, cell_height, i * cell_width, 0,
+				i % loop_chars < ncp ? cps[i % loop_chars] : ' ', fg, bg);
+		mq->key = key;
+		wlr_scene_buffer_set_buffer(mq->node, &mq->buf->base);
+	}
+
+	wlr_scene_node_set_position(&mq->node->node, x, y);
+	wlr_scene_buffer_set_dest_size(mq->node, mq->view_w, cell_height);
+	wlr_scene_node_set_enabled(&mq->node->node, 1);
+	marquee_count(mq, m);
+	/* Stay above the frame or bar buffer it overlays */
+	wlr_scene_node_raise_to_top(&mq->node->node);
+	marquee_scroll(mq);
+}
+
+/* Move the visible window of the strip to the current scroll offset */
+void
+marquee_scroll(Marquee *mq)
+{
+	if (!mq->shown)
+		return;
+	wlr_scene_buffer_set_source_box(mq->node, &(struct wlr_fbox){
+		.x = title_scroll_offset % mq->loop_w,
+		.y = 0,
+		.width = mq->view_w,
+		.height = cell_height,
+	});
+}
+
+/* Re-enable a marquee hidden with its client; the strip is still valid */
+void
+marquee_show(Marquee *mq, Monitor *m)
+{
+	if (!mq->node || !mq->buf)
+		return;
+	if (mq->shown) {
+		/* Already moving; the client may have changed outputs */
+		marquee_count(mq, m);
+		return;
+	}
+	wlr_scene_node_set_enabled(&mq->node->node, 1);
+	marquee_count(mq, m);
+	marquee_scroll(mq);
+}
+
+void
+marquee_hide(Marquee *mq)
+{
+	if (mq->node)
+		wlr_scene_node_set_enabled(&mq->node->node, 0);
+	if (mq->shown) {
+		mq->shown = 0;
+		scrollref(mq->mon, -1);
+	}
+}
+
+void
+marquee_destroy(Marquee *mq)
+{
+	if (mq->node)
+		wlr_scene_node_destroy(&mq->node->node);
+	if (mq->buf)
+		wlr_buffer_drop(&mq->buf->base);
+	if (mq->shown)
+		scrollref(mq->mon, -1);
+	memset(mq, 0, sizeof(*mq));
+}
+
+/* Atlas slot of a codepoint: printable ASCII, Latin-1 and the box-drawing
+ * and block ranges the frames use. -1 if the atlas doesn't have it. */
+static int
+atlas_index(unsigned long cp)
+{
+	if (cp >= 0x20 && cp <= 0x7E)
+		return cp - 0x20;
+	if (cp >= 0xA0 && cp <= 0xFF)
+		return 95 + cp - 0xA0;
+	if (cp >= 0x2500 && cp <= 0x259F)
+		return 191 + cp - 0x2500;
+	return -1;
+}
+
+static void
+glyph_atlas_free(GlyphAtlas *a)
+{
+	wl_list_remove(&a->link);
+	/* Cells still showing it keep their own lock */
+	wlr_buffer_unlock(&a->buf->base);
+	free(a);
+}
+
+/* The atlas for (fg, bg) with the current font, rasterized and uploaded on
+ * first use. Kept most recently used first, at most ATLAS_MAX variants. */
+GlyphAtlas *
+glyph_atlas_get(uint32_t fg, uint32_t bg)
+{
+	GlyphAtlas *a, *tmp;
+	struct TitleBuffer *tb;
+	int n = 0, w, h, i, idx;
+	unsigned long cp;
+
+	wl_list_for_each_safe(a, tmp, &glyph_atlases, link) {
+		if (a->font_serial != font_serial) {
+			glyph_atlas_free(a);
+		} else if (a->fg == fg && a->bg == bg) {
+			wl_list_remove(&a->link);
+			wl_list_insert(&glyph_atlases, &a->link);
+			return a;
+		} else if (++n >= ATLAS_MAX) {
+			glyph_atlas_free(a);
 		}
 	}
+	if (!drw)
+		return NULL;
+
+	w = ATLAS_COLS * cell_width;
+	h = (ATLAS_GLYPHS + ATLAS_COLS - 1) / ATLAS_COLS * cell_height;
+	tb = titlebuf_create(w, h);
+	for (i = 0; i < w * h; i++)
+		((uint32_t *)tb->data)[i] = bg;
+	for (cp = 0x20; cp <= 0x259F; cp++) {
+		if ((idx = atlas_index(cp)) < 0)
+			continue;
+		draw_cell(tb->data, w, h, idx % ATLAS_COLS * cell_width,
+			idx / ATLAS_COLS * cell_height, cp, fg, bg);
+	}
+
+	/* A client buffer carries its texture, so every cell node showing the
+	 * atlas shares one upload (with pixman too, which has no upload) */
+	a = ecalloc(1, sizeof(*a));
+	a->buf = wlr_client_buffer_create(&tb->base, drw);
+	wlr_buffer_drop(&tb->base);
+	if (!a->buf) {
+		tbwm_log(TBWM_LOG_ERROR, "tbwm: couldn't upload glyph atlas\n");
+		free(a);
+		return NULL;
+	}
+	a->fg = fg;
+	a->bg = bg;
+	a->font_serial = font_serial;
+	wl_list_insert(&glyph_atlases, &a->link);
+	atlas_upload_count++;
+	return a;
 }
 
+/* Drop every atlas, e.g. before the renderer that owns their textures goes */
 void
-updateframe(Client *c)
+glyph_atlas_clear(void)
+{
+	GlyphAtlas *a, *tmp;
+	Client *c;
+
+	wl_list_for_each(c, &clients, link) {
+		atlastext_destroy(&c->title_text);
+		c->frame_state_valid = 0;
+	}
+	wl_list_for_each_safe(a, tmp, &glyph_atlases, link)
+		glyph_atlas_free(a);
+}
+
+/* Show cps as n cell nodes at x,y in parent. Cells whose glyph and colors
+ * didn't change are left alone; the rest only get a new source box (and
+ * atlas, if the colors changed). Codepoints outside the atlas get a private
+ * one-cell buffer. */
+void
+atlastext_set(AtlasText *t, struct wlr_scene_tree *parent, int x, int y,
+		const unsigned long *cps, int n, uint32_t fg, uint32_t bg)
+{
+	GlyphAtlas *a = glyph_atlas_get(fg, bg);
+	AtlasCell *cell;
+	int i, idx;
+
+	if (n > t->cap) {
+		AtlasCell *tmp = realloc(t->cells, n * sizeof(*tmp));
+		if (!tmp) {
+			tbwm_log(TBWM_LOG_ERROR, "tbwm: out of memory growing atlas text\n");
+			n = t->cap;
+		} else {
+			memset(tmp + t->cap, 0, (n - t->cap) * sizeof(*tmp));
+			t->cells = tmp;
+			t->cap = n;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		cell = &t->cells[i];
+		if (!cell->node)
+			cell->node = wlr_scene_buffer_create(parent, NULL);
+		wlr_scene_node_set_position(&cell->node->node, x + i * cell_width, y);
+		wlr_scene_node_set_enabled(&cell->node->node, 1);
+
+		idx = a ? atlas_index(cps[i]) : -1;
+		if (idx >= 0) {
+			if (cell->shown == &a->buf->base && cell->cp == cps[i])
+				continue;
+			if (cell->shown != &a->buf->base) {
+				wlr_scene_buffer_set_buffer(cell->node, &a->buf->base);
+				cell->shown = &a->buf->base;
+			}
+			wlr_scene_buffer_set_source_box(cell->node, &(struct wlr_fbox){
+				.x = idx % ATLAS_COLS * cell_width,
+				.y = idx / ATLAS_COLS * cell_height,
+				.width = cell_width,
+				.height = cell_height,
+			});
+			wlr_scene_buffer_set_dest_size(cell->node, cell_width, cell_height);
+			if (cell->own) {
+				wlr_buffer_drop(&cell->own->base);
+				cell->own = NULL;
+			}
+		} else {
+			if (cell->own && cell->shown == &cell->own->base && cell->cp == cps[i]
+					&& cell->fg == fg && cell->bg == bg && cell->font_serial == font_serial)
+				continue;
+			if (cell->own && (cell->own->base.width != cell_width
+					|| cell->own->base.height != cell_height)) {
+				wlr_scene_buffer_set_buffer(cell->node, NULL);
+				wlr_buffer_drop(&cell->own->base);
+				cell->own = NULL;
+			}
+			if (!cell->own) {
+				cell->own = titlebuf_create(cell_width, cell_height);
+			}
+			draw_cell(cell->own->data, cell_width, cell_height, 0, 0, cps[i], fg, bg);
+			wlr_scene_buffer_set_source_box(cell->node, NULL);
+			wlr_scene_buffer_set_dest_size(cell->node, 0, 0);
+			wlr_scene_buffer_set_buffer(cell->node, &cell->own->base);
+			cell->shown = &cell->own->base;
+		}
+		cell->cp = cps[i];
+		cell->fg = fg;
+		cell->bg = bg;
+		cell->font_serial = font_serial;
+	}
+	for (i = n; i < t->count; i++)
+		wlr_scene_node_set_enabled(&t->cells[i].node->node, 0);
+	t->count = n;
+}
+
+void
+atlastext_hide(AtlasText *t)
+{
+	int i;
+
+	for (i = 0; i < t->count; i++)
+		wlr_scene_node_set_enabled(&t->cells[i].node->node, 0);
+	t->count = 0;
+}
+
+void
+atlastext_destroy(AtlasText *t)
+{
+	int i;
+
+	for (i = 0; i < t->cap; i++) {
+		if (t->cells[i].node)
+			wlr_scene_node_destroy(&t->cells[i].node->node);
+		if (t->cells[i].own)
+			wlr_buffer_drop(&t->cells[i].own->base);
+	}
+	free(t->cells);
+	memset(t, 0, sizeof(*t));
+}
+
+/* Window title in text-atlas mode, over the bare top strip: atlas cells, or
+ * the marquee when it scrolls. A title change rasterizes nothing. */
+void
+frame_title_atlas(Client *c, const char *title, int width, int focused)
+{
+	unsigned long cps[256];
+	int ncp = 0, pos = 0, avail, btn_start_cell, title_right_px, i;
+	uint32_t fg, bg;
+
+	while (title[pos] && ncp < 255)
+		cps[ncp++] = utf8_decode(title, &pos);
+
+	/* Same title area as renderframe(): cell 2 up to one cell left of [F] */
+	btn_start_cell = MAX(width / cell_width - 9, 3);
+	title_right_px = MAX((btn_start_cell - 1) * cell_width, cell_width * 2);
+	avail = (title_right_px - cell_width * 2) / cell_width;
+
+	/* Inverted only for the focused window */
+	fg = RGB_TO_ARGB(focused ? cfg_border_color : cfg_border_line_color);
+	bg = RGB_TO_ARGB(focused ? cfg_border_line_color : cfg_border_color);
+
+	c->needs_title_scroll = ncp > avail && title_scroll_mode;
+	if (c->needs_title_scroll) {
+		atlastext_hide(&c->title_text);
+		marquee_update(&c->title_marquee, c->mon, c->scene, cell_width * 2, 0,
+			avail * cell_width, cps, ncp, fg, bg);
+		return;
+	}
+	marquee_hide(&c->title_marquee);
+	if (ncp > avail) {
+		/* Truncate with ellipsis */
+		ncp = MAX(avail - 3, 0);
+		for (i = 0; i < 3; i++)
+			cps[ncp++] = '.';
+	}
+	atlastext_set(&c->title_text, c->scene, cell_width * 2, 0, cps, ncp, fg, bg);
+}
+
+void
+renderframe(Client *c)
 {
 	const char *title;
-	int width, height, i, x;
+	int width, height, i;
 	int above, below, left, right;
 	int focused;
 	int title_len;
 	unsigned long tl_char, tr_char, bl_char, br_char;
 	unsigned long h_line, v_line;
 	uint32_t bg_color;
-	struct TitleBuffer *tb;
 	uint32_t *pixels;
 	int dims_changed;
+	FrameState fs;
 
 	if (!c || !c->mon)
 		return;
 
 	/* Hide frames when fullscreen */
 	if (c->isfullscreen) {
+		c->frame_state_valid = 0;
+		c->needs_title_scroll = 0;
+		marquee_hide(&c->title_marquee);
+		atlastext_hide(&c->title_text);
 		if (c->frame_top)
 			wlr_scene_buffer_set_buffer(c->frame_top, NULL);
-		if (c->frame_bottom)
-			wlr_scene_buffer_set_buffer(c->frame_bottom, NULL);
-		if (c->frame_left)
-			wlr_scene_buffer_set_buffer(c->frame_left, NULL);
-		if (c->frame_right)
-			wlr_scene_buffer_set_buffer(c->frame_right, NULL);
+		frame_set_side(c, &c->frame_bottom, &c->frame_bottom_strip, NULL, 0, 0);
+		frame_set_side(c, &c->frame_left, &c->frame_left_strip, NULL, 0, 0);
+		frame_set_side(c, &c->frame_right, &c->frame_right_strip, NULL, 0, 0);
+		frame_set_side_bg(c, &c->frame_left_bg, 0, 0, 0, 0, 0);
+		frame_set_side_bg(c, &c->frame_right_bg, 0, 0, 0, 0, 0);
 		return;
 	}
 
@@ -7769,47 +9926,57 @@ updateframe(Client *c)
 	if (width <= 0 || height <= 0)
 		return;
 
-	/* Check if dimensions changed - if so, we need to reallocate buffers */
+	/* Check if this window is focused */
+	focused = (focustop(c->mon) == c);
+
+	/* Neighbor mask from the last arrange; floating windows have none */
+	above = !c->isfloating && (c->neighbors & NEIGHBOR_ABOVE);
+	below = !c->isfloating && (c->neighbors & NEIGHBOR_BELOW);
+	left  = !c->isfloating && (c->neighbors & NEIGHBOR_LEFT);
+	right = !c->isfloating && (c->neighbors & NEIGHBOR_RIGHT);
+
+	/* Nothing to do if the frame would come out identical; this is the
+	 * common case for clients committing new content every frame. */
+	memset(&fs, 0, sizeof(fs));
+	fs.width = width;
+	fs.height = height;
+	fs.cell_w = cell_width;
+	fs.cell_h = cell_height;
+	fs.focused = focused;
+	fs.neighbors = above | below << 1 | left << 2 | right << 3;
+	/* In text-atlas mode the title is drawn over the strip, not into it */
+	fs.title_hash = cfg_text_atlas ? 0 : frame_title_hash(title);
+	fs.border_color = cfg_border_color;
+	fs.line_color = cfg_border_line_color;
+	fs.scroll_mode = title_scroll_mode;
+	fs.text_atlas = cfg_text_atlas;
+	fs.font_serial = font_serial;
+	if (c->frame_state_valid && memcmp(&fs, &c->frame_state, sizeof(fs)) == 0) {
+		if (cfg_text_atlas)
+			frame_title_atlas(c, title, width, focused);
+		frame_set_filter(c);
+		frame_skip_count++;
+		return;
+	}
+	c->frame_state = fs;
+	c->frame_state_valid = 1;
+	frame_redraw_count++;
+
+	/* Check if dimensions changed - if so, we need to reallocate the title
+	 * buffer (shared strips are swapped below as needed) */
 	dims_changed = (width != c->frame_width || height != c->frame_height);
 	if (dims_changed) {
 		/* Release old cached buffers properly - scene must release first, then we drop our ref */
 		if (c->frame_top_buf) {
 			if (c->frame_top)
 				wlr_scene_buffer_set_buffer(c->frame_top, NULL);
-			wlr_buffer_drop(&c->frame_top_buf->base);
+			titlebuf_recycle(c->frame_top_buf);
 			c->frame_top_buf = NULL;
 		}
-		if (c->frame_bottom_buf) {
-			if (c->frame_bottom)
-				wlr_scene_buffer_set_buffer(c->frame_bottom, NULL);
-			wlr_buffer_drop(&c->frame_bottom_buf->base);
-			c->frame_bottom_buf = NULL;
-		}
-		if (c->frame_left_buf) {
-			if (c->frame_left)
-				wlr_scene_buffer_set_buffer(c->frame_left, NULL);
-			wlr_buffer_drop(&c->frame_left_buf->base);
-			c->frame_left_buf = NULL;
-		}
-		if (c->frame_right_buf) {
-			if (c->frame_right)
-				wlr_scene_buffer_set_buffer(c->frame_right, NULL);
-			wlr_buffer_drop(&c->frame_right_buf->base);
-			c->frame_right_buf = NULL;
-		}
 		c->frame_width = width;
 		c->frame_height = height;
 	}
 
-	/* Check if this window is focused */
-	focused = (focustop(c->mon) == c);
-
-	/* Check for neighbors */
-	above = has_neighbor(c, 0);
-	below = has_neighbor(c, 1);
-	left  = has_neighbor(c, 2);
-	right = has_neighbor(c, 3);
-
 	/* Always use double-line characters */
 	h_line = 0x2550; /* ═ double horizontal */
 	v_line = 0x2551; /* ║ double vertical */
@@ -7839,24 +10006,16 @@ updateframe(Client *c)
 	bg_color = RGB_TO_ARGB(cfg_border_color);
 
 	/* === TOP FRAME === */
-	/* Reuse buffer if dimensions match, otherwise allocate new */
-	if (!c->frame_top_buf) {
-		c->frame_top_buf = ecalloc(1, sizeof(*c->frame_top_buf));
-		c->frame_top_buf->stride = width * 4;
-		c->frame_top_buf->data = ecalloc(1, c->frame_top_buf->stride * cell_height);
-		wlr_buffer_init(&c->frame_top_buf->base, &titlebuf_impl, width, cell_height);
-		titlebuf_alloc_count++;
-	}
-	tb = c->frame_top_buf;
-	pixels = tb->data;
+	/* Drawn off to the side; buffer_commit() swaps in a pooled buffer */
+	pixels = draw_scratch(width, cell_height);
 	
 	/* Clear buffer */
 	for (i = 0; i < width * cell_height; i++)
 		pixels[i] = bg_color;
 
 	/* Format: ╔═ title ═╗ with horizontal lines filling the rest */
-	render_char_to_buffer(pixels, width, cell_height, 0, 0, tl_char, RGB_TO_ARGB(cfg_border_line_color));
-	render_char_to_buffer(pixels, width, cell_height, cell_width, 0, h_line, RGB_TO_ARGB(cfg_border_line_color));
+	draw_cell(pixels, width, cell_height, 0, 0, tl_char, RGB_TO_ARGB(cfg_border_line_color), bg_color);
+	draw_cell(pixels, width, cell_height, cell_width, 0, h_line, RGB_TO_ARGB(cfg_border_line_color), bg_color);
 	
 	/* Calculate title positioning */
 	title_len = 0;
@@ -7886,12 +10045,10 @@ updateframe(Client *c)
 		
 		/* Update scroll flag for this client */
 		c->needs_title_scroll = (needs_overflow && title_scroll_mode) ? 1 : 0;
-		if (c->needs_title_scroll)
-			any_title_needs_scroll = 1;
 		
 		/* Fill cells 2 to (title_right_px) with h_line first (leave room for buttons) */
 		for (fill_x = cell_width * 2; fill_x < title_right_px; fill_x += cell_width) {
-			render_char_to_buffer(pixels, width, cell_height, fill_x, 0, h_line, RGB_TO_ARGB(cfg_border_line_color));
+			draw_cell(pixels, width, cell_height, fill_x, 0, h_line, RGB_TO_ARGB(cfg_border_line_color), bg_color);
 		}
 		
 		/* Title colors: inverted only for focused window */
@@ -7907,13 +10064,16 @@ updateframe(Client *c)
 		title_start_cell = 2;
 		title_x = title_start_cell * cell_width;
 		
-		if (needs_overflow && title_scroll_mode) {
-			/* Smooth pixel-based scrolling: title + "  " loops around */
-			int scroll_chars = title_len + 2; /* +2 for "  " separator */
-			int total_scroll_width = scroll_chars * cell_width;
-			int pixel_offset = title_scroll_offset % total_scroll_width;
-			int display_width = avail_cells * cell_width;
-			int bg_end = title_x + display_width;
+		if (cfg_text_atlas) {
+			/* Title cells come from the glyph atlas, over the bare h_line */
+			frame_title_atlas(c, title, width, focused);
+		} else if (needs_overflow && title_scroll_mode) {
+			atlastext_hide(&c->title_text);
+			/* Smooth scrolling: the title loops in a marquee strip that
+			 * scrolltick() moves via its source box */
+			unsigned long title_cps[256];
+			int title_cp_count = 0, utf8_pos = 0;
+			int bg_end = title_x + avail_cells * cell_width;
 			if (bg_end > title_right_px)
 				bg_end = title_right_px;
 			
@@ -7924,34 +10084,13 @@ updateframe(Client *c)
 				}
 			}
 			
-			/* Render characters at pixel-offset positions with clipping */
-			{
-				int char_idx;
-				int draw_x;
-				int clip_left = title_x;
-				int clip_right = bg_end;
-				for (char_idx = 0; char_idx < scroll_chars + avail_cells; char_idx++) {
-					int src_char = char_idx % scroll_chars;
-					int char_pixel_pos = char_idx * cell_width - pixel_offset;
-					unsigned long cp;
-					draw_x = title_x + char_pixel_pos;
-					
-					if (src_char < title_len) {
-						/* Get character from title */
-						int pos = 0;
-						int ci = 0;
-						while (ci < src_char && title[pos]) {
-							utf8_decode(title, &pos);
-							ci++;
-						}
-						cp = title[pos] ? utf8_decode(title, &pos) : ' ';
-					} else {
-						cp = ' '; /* separator spaces */
-					}
-					render_char_clipped(pixels, width, cell_height, draw_x, 0, cp, title_fg, clip_left, clip_right);
-				}
-			}
+			while (title[utf8_pos] && title_cp_count < 255)
+				title_cps[title_cp_count++] = utf8_decode(title, &utf8_pos);
+			marquee_update(&c->title_marquee, c->mon, c->scene, title_x, 0, bg_end - title_x,
+				title_cps, title_cp_count, title_fg, title_bg);
 		} else if (needs_overflow) {
+			marquee_hide(&c->title_marquee);
+			atlastext_hide(&c->title_text);
 			/* Truncate mode with ellipsis */
 			int ellipsis_cells = 3;
 			int text_cells = avail_cells - ellipsis_cells;
@@ -7976,19 +10115,21 @@ updateframe(Client *c)
 				int rendered = 0;
 				while (rendered < text_cells && title[pos]) {
 					unsigned long cp = utf8_decode(title, &pos);
-					render_char_to_buffer(pixels, width, cell_height, title_x, 0, cp, title_fg);
+					draw_cell(pixels, width, cell_height, title_x, 0, cp, title_fg, title_bg);
 					title_x += cell_width;
 					rendered++;
 				}
 			}
 			
 			/* Ellipsis */
-			render_char_to_buffer(pixels, width, cell_height, title_x, 0, '.', title_fg);
+			draw_cell(pixels, width, cell_height, title_x, 0, '.', title_fg, title_bg);
 			title_x += cell_width;
-			render_char_to_buffer(pixels, width, cell_height, title_x, 0, '.', title_fg);
+			draw_cell(pixels, width, cell_height, title_x, 0, '.', title_fg, title_bg);
 			title_x += cell_width;
-			render_char_to_buffer(pixels, width, cell_height, title_x, 0, '.', title_fg);
+			draw_cell(pixels, width, cell_height, title_x, 0, '.', title_fg, title_bg);
 		} else {
+			marquee_hide(&c->title_marquee);
+			atlastext_hide(&c->title_text);
 			/* Title fits - render normally */
 			/* Fill background */
 			{
@@ -8009,7 +10150,7 @@ updateframe(Client *c)
 				int rendered = 0;
 				while (rendered < title_cells && title[pos]) {
 					unsigned long cp = utf8_decode(title, &pos);
-					render_char_to_buffer(pixels, width, cell_height, title_x, 0, cp, title_fg);
+					draw_cell(pixels, width, cell_height, title_x, 0, cp, title_fg, title_bg);
 					title_x += cell_width;
 					rendered++;
 				}
@@ -8033,133 +10174,182 @@ updateframe(Client *c)
 
 		/* left padding line (single ═) immediately before [F] */
 		if (bx - cell_width >= 0)
-			render_char_to_buffer(pixels, width, cell_height, bx - cell_width, 0, h_line, line_col);
+			draw_cell(pixels, width, cell_height, bx - cell_width, 0, h_line, line_col, bg_color);
 
 		/* [F] */
-		render_char_to_buffer(pixels, width, cell_height, bx, 0, '[', line_col);
-		render_char_to_buffer(pixels, width, cell_height, bx + cell_width, 0, 'F', line_col);
-		render_char_to_buffer(pixels, width, cell_height, bx + cell_width * 2, 0, ']', line_col);
+		draw_cell(pixels, width, cell_height, bx, 0, '[', line_col, bg_color);
+		draw_cell(pixels, width, cell_height, bx + cell_width, 0, 'F', line_col, bg_color);
+		draw_cell(pixels, width, cell_height, bx + cell_width * 2, 0, ']', line_col, bg_color);
 		/* separator ═ */
-		render_char_to_buffer(pixels, width, cell_height, bx + cell_width * 3, 0, h_line, line_col);
+		draw_cell(pixels, width, cell_height, bx + cell_width * 3, 0, h_line, line_col, bg_color);
 
 		/* [X] */
-		render_char_to_buffer(pixels, width, cell_height, bx + cell_width * 4, 0, '[', line_col);
-		render_char_to_buffer(pixels, width, cell_height, bx + cell_width * 5, 0, 'X', line_col);
-		render_char_to_buffer(pixels, width, cell_height, bx + cell_width * 6, 0, ']', line_col);
+		draw_cell(pixels, width, cell_height, bx + cell_width * 4, 0, '[', line_col, bg_color);
+		draw_cell(pixels, width, cell_height, bx + cell_width * 5, 0, 'X', line_col, bg_color);
+		draw_cell(pixels, width, cell_height, bx + cell_width * 6, 0, ']', line_col, bg_color);
 		/* End corner (leave a single padding line between buttons and corner) */
-		render_char_to_buffer(pixels, width, cell_height, width - cell_width * 2, 0, h_line, line_col);
-		render_char_to_buffer(pixels, width, cell_height, width - cell_width, 0, tr_char, line_col);
+		draw_cell(pixels, width, cell_height, width - cell_width * 2, 0, h_line, line_col, bg_color);
+		draw_cell(pixels, width, cell_height, width - cell_width, 0, tr_char, line_col, bg_color);
 	}
 
 	if (!c->frame_top)
 		c->frame_top = wlr_scene_buffer_create(c->scene, NULL);
 	wlr_scene_node_set_position(&c->frame_top->node, 0, 0);
-	wlr_scene_buffer_set_buffer(c->frame_top, &tb->base);
+	buffer_commit(c->frame_top, &c->frame_top_buf, width, cell_height);
 	/* Don't drop - we're caching the buffer for reuse */
 
 	/* === BOTTOM FRAME === */
 	/* Only draw if no neighbor below (neighbor draws the shared border) */
-	if (!below) {
-		/* Reuse buffer if dimensions match */
-		if (!c->frame_bottom_buf) {
-			c->frame_bottom_buf = ecalloc(1, sizeof(*c->frame_bottom_buf));
-			c->frame_bottom_buf->stride = width * 4;
-			c->frame_bottom_buf->data = ecalloc(1, c->frame_bottom_buf->stride * cell_height);
-			wlr_buffer_init(&c->frame_bottom_buf->base, &titlebuf_impl, width, cell_height);
-			titlebuf_alloc_count++;
-		}
-		tb = c->frame_bottom_buf;
-		pixels = tb->data;
-		
-		/* Clear buffer */
-		for (i = 0; i < width * cell_height; i++)
-			pixels[i] = bg_color;
-
-		render_char_to_buffer(pixels, width, cell_height, 0, 0, bl_char, RGB_TO_ARGB(cfg_border_line_color));
-		
-		for (x = cell_width; x < width - cell_width; x += cell_width)
-			render_char_to_buffer(pixels, width, cell_height, x, 0, h_line, RGB_TO_ARGB(cfg_border_line_color));
-		
-		render_char_to_buffer(pixels, width, cell_height, width - cell_width, 0, br_char, RGB_TO_ARGB(cfg_border_line_color));
+	frame_set_side(c, &c->frame_bottom, &c->frame_bottom_strip,
+		below ? NULL : borderstrip_get(0, width, bl_char, h_line, br_char,
+			RGB_TO_ARGB(cfg_border_line_color), bg_color),
+		0, height - cell_height);
+
+	/* === LEFT AND RIGHT FRAMES === */
+	/* Whole rows of ║ over a background rect covering the side. The left
+	 * side is always drawn for focused windows (so focus color shows),
+	 * otherwise only if no neighbor; a neighbor to the right skips its
+	 * left border, so the right side is always drawn. */
+	{
+		int side_height = height - 2 * cell_height;
+		int rows = side_height / cell_height;
+		int show_left = rows > 0 && (focused || !left);
+		BorderStrip *side = NULL;
 
-		if (!c->frame_bottom)
-			c->frame_bottom = wlr_scene_buffer_create(c->scene, NULL);
-		wlr_scene_node_set_position(&c->frame_bottom->node, 0, height - cell_height);
-		wlr_scene_buffer_set_buffer(c->frame_bottom, &tb->base);
-		/* Don't drop - we're caching the buffer for reuse */
-	} else if (c->frame_bottom) {
-		wlr_scene_buffer_set_buffer(c->frame_bottom, NULL);
+		if (rows > 0)
+			side = borderstrip_get(1, rows * cell_height, v_line, v_line, v_line,
+				RGB_TO_ARGB(cfg_border_line_color), bg_color);
+		frame_set_side_bg(c, &c->frame_left_bg, show_left, 0, cell_height, cell_width, side_height);
+		frame_set_side_bg(c, &c->frame_right_bg, rows > 0, width - cell_width, cell_height,
+			cell_width, side_height);
+		if (side && show_left)
+			side->refs++;
+		frame_set_side(c, &c->frame_left, &c->frame_left_strip, show_left ? side : NULL,
+			0, cell_height);
+		frame_set_side(c, &c->frame_right, &c->frame_right_strip, side,
+			width - cell_width, cell_height);
 	}
+	frame_set_filter(c);
+}
 
-	/* === LEFT FRAME === */
-	/* Always draw for focused windows (so focus color shows), otherwise only if no neighbor */
-	if (focused || !left) {
-		int side_height = height - 2 * cell_height;
-		int rows = side_height / cell_height;
-		
-		if (rows > 0) {
-			/* Reuse buffer if dimensions match */
-			if (!c->frame_left_buf) {
-				c->frame_left_buf = ecalloc(1, sizeof(*c->frame_left_buf));
-				c->frame_left_buf->stride = cell_width * 4;
-				c->frame_left_buf->data = ecalloc(1, c->frame_left_buf->stride * side_height);
-				wlr_buffer_init(&c->frame_left_buf->base, &titlebuf_impl, cell_width, side_height);
-				titlebuf_alloc_count++;
-			}
-			tb = c->frame_left_buf;
-			pixels = tb->data;
-			
-			/* Clear buffer */
-			for (i = 0; i < cell_width * side_height; i++)
-				pixels[i] = bg_color;
+/* Give c's frame nodes the UI filter of its output */
+void
+frame_set_filter(Client *c)
+{
+	int i;
+
+	ui_filter_set(c->frame_top, c->mon);
+	ui_filter_set(c->frame_bottom, c->mon);
+	ui_filter_set(c->frame_left, c->mon);
+	ui_filter_set(c->frame_right, c->mon);
+	ui_filter_set(c->title_marquee.node, c->mon);
+	for (i = 0; i < c->title_text.count; i++)
+		ui_filter_set(c->title_text.cells[i].node, c->mon);
+}
+
+/* Find or rasterize a strip: `len` pixels of cells (first, mid..., last),
+ * laid out like the old per-client frame buffers. Returns a new reference. */
+BorderStrip *
+borderstrip_get(int vertical, int len, unsigned long first, unsigned long mid,
+		unsigned long last, uint32_t fg, uint32_t bg)
+{
+	BorderStrip *s;
+	uint32_t *pixels;
+	int w, h, pos, i, step = vertical ? cell_height : cell_width;
 
-			for (i = 0; i < rows; i++)
-				render_char_to_buffer(pixels, cell_width, side_height, 0, i * cell_height, v_line, RGB_TO_ARGB(cfg_border_line_color));
+	if (len <= 0)
+		return NULL;
 
-			if (!c->frame_left)
-				c->frame_left = wlr_scene_buffer_create(c->scene, NULL);
-			wlr_scene_node_set_position(&c->frame_left->node, 0, cell_height);
-			wlr_scene_buffer_set_buffer(c->frame_left, &tb->base);
-			/* Don't drop - we're caching the buffer for reuse */
+	wl_list_for_each(s, &border_strips, link) {
+		if (s->vertical == vertical && s->len == len && s->first == first
+				&& s->mid == mid && s->last == last && s->fg == fg
+				&& s->bg == bg && s->font_serial == font_serial) {
+			s->refs++;
+			return s;
 		}
-	} else if (c->frame_left) {
-		wlr_scene_buffer_set_buffer(c->frame_left, NULL);
 	}
 
-	/* === RIGHT FRAME === */
-	/* Always draw right border - neighbor to right will skip its left border */
-	{
-		int side_height = height - 2 * cell_height;
-		int rows = side_height / cell_height;
-		
-		if (rows > 0) {
-			/* Reuse buffer if dimensions match */
-			if (!c->frame_right_buf) {
-				c->frame_right_buf = ecalloc(1, sizeof(*c->frame_right_buf));
-				c->frame_right_buf->stride = cell_width * 4;
-				c->frame_right_buf->data = ecalloc(1, c->frame_right_buf->stride * side_height);
-				wlr_buffer_init(&c->frame_right_buf->base, &titlebuf_impl, cell_width, side_height);
-				titlebuf_alloc_count++;
-			}
-			tb = c->frame_right_buf;
-			pixels = tb->data;
-			
-			/* Clear buffer */
-			for (i = 0; i < cell_width * side_height; i++)
-				pixels[i] = bg_color;
+	w = vertical ? cell_width : len;
+	h = vertical ? len : cell_height;
+	s = ecalloc(1, sizeof(*s));
+	s->buf = titlebuf_create(w, h);
+	pixels = s->buf->data;
+	for (i = 0; i < w * h; i++)
+		pixels[i] = bg;
 
-			for (i = 0; i < rows; i++)
-				render_char_to_buffer(pixels, cell_width, side_height, 0, i * cell_height, v_line, RGB_TO_ARGB(cfg_border_line_color));
+	/* first at 0, mid in whole cells, last flush with the end */
+	for (pos = 0; pos + step <= len; pos += step)
+		draw_cell(pixels, w, h, vertical ? 0 : pos, vertical ? pos : 0,
+			pos == 0 ? first : mid, fg, bg);
+	if (len > step)
+		draw_cell(pixels, w, h, vertical ? 0 : len - step, vertical ? len - step : 0,
+			last, fg, bg);
 
-			if (!c->frame_right)
-				c->frame_right = wlr_scene_buffer_create(c->scene, NULL);
-			wlr_scene_node_set_position(&c->frame_right->node, width - cell_width, cell_height);
-			wlr_scene_buffer_set_buffer(c->frame_right, &tb->base);
-			/* Don't drop - we're caching the buffer for reuse */
-		} else if (c->frame_right) {
-			wlr_scene_buffer_set_buffer(c->frame_right, NULL);
-		}
+	s->vertical = vertical;
+	s->len = len;
+	s->first = first;
+	s->mid = mid;
+	s->last = last;
+	s->fg = fg;
+	s->bg = bg;
+	s->font_serial = font_serial;
+	s->refs = 1;
+	wl_list_insert(&border_strips, &s->link);
+	return s;
+}
+
+void
+borderstrip_put(BorderStrip *s)
+{
+	if (!s || --s->refs > 0)
+		return;
+	wl_list_remove(&s->link);
+	wlr_buffer_drop(&s->buf->base);
+	free(s);
+}
+
+/* Show strip (taking over the caller's reference) in *node at x,y, or hide
+ * the side when strip is NULL. Keeping the same strip touches nothing, so
+ * its texture isn't re-uploaded. */
+void
+frame_set_side(Client *c, struct wlr_scene_buffer **node, BorderStrip **held,
+		BorderStrip *strip, int x, int y)
+{
+	if (strip && !*node)
+		*node = wlr_scene_buffer_create(c->scene, NULL);
+	if (strip)
+		wlr_scene_node_set_position(&(*node)->node, x, y);
+
+	if (strip == *held) {
+		borderstrip_put(strip);
+		return;
 	}
+	if (*node)
+		wlr_scene_buffer_set_buffer(*node, strip ? &strip->buf->base : NULL);
+	borderstrip_put(*held);
+	*held = strip;
+}
+
+/* Background of a side column: a rect, so the strip above it only carries
+ * whole rows and is shared by every window with as many rows */
+void
+frame_set_side_bg(Client *c, struct wlr_scene_rect **rect, int show,
+		int x, int y, int w, int h)
+{
+	float color[4];
+
+	if (!show) {
+		if (*rect)
+			wlr_scene_node_set_enabled(&(*rect)->node, 0);
+		return;
+	}
+	rgb_to_float(cfg_border_color, color);
+	if (!*rect)
+		*rect = wlr_scene_rect_create(c->scene, w, h, color);
+	wlr_scene_rect_set_size(*rect, w, h);
+	wlr_scene_rect_set_color(*rect, color);
+	wlr_scene_node_set_position(&(*rect)->node, x, y);
+	wlr_scene_node_set_enabled(&(*rect)->node, 1);
 }
 
 void
@@ -8186,7 +10376,9 @@ tag(const Arg *arg)
 		sel->dwindle = NULL;
 	}
 	
+	clientcount(sel, -1);
 	sel->tags = arg->ui & TAGMASK;
+	clientcount(sel, 1);
 	focusclient(focustop(selmon), 1);
 	arrange(selmon);
 	printstatus();
@@ -8209,10 +10401,7 @@ tile(Monitor *m)
 	int stack_x, stack_w;
 	Client *c;
 
-	wl_list_for_each(c, &clients, link)
-		if (VISIBLEON(c, m) && !c->isfloating && !c->isfullscreen)
-			n++;
-	if (n == 0)
+	if ((n = m->nvisible_tiled) == 0)
 		return;
 
 	/* Count windows in master and stack */
@@ -8237,7 +10426,7 @@ tile(Monitor *m)
 	
 	i = my = ty = 0;
 
-	wl_list_for_each(c, &clients, link) {
+	wl_list_for_each(c, &m->clients, mlink) {
 		int h_cells, h, remaining;
 		int is_first;
 		if (!VISIBLEON(c, m) || c->isfloating || c->isfullscreen)
@@ -8258,12 +10447,12 @@ tile(Monitor *m)
 			}
 			h = h_cells * cell_height;
 			
-			resize(c, (struct wlr_box){
+			layout_place(m, c, (struct wlr_box){
 				.x = m->w.x,
 				.y = m->w.y + my,
 				.width = mw,
 				.height = h
-			}, 0);
+			});
 			
 			/* Next window overlaps by 1 cell (shared border) */
 			my += h - cell_height;
@@ -8281,12 +10470,12 @@ tile(Monitor *m)
 			}
 			h = h_cells * cell_height;
 			
-			resize(c, (struct wlr_box){
+			layout_place(m, c, (struct wlr_box){
 				.x = stack_x,
 				.y = m->w.y + ty,
 				.width = stack_w,
 				.height = h
-			}, 0);
+			});
 			
 			ty += h - cell_height;
 		}
@@ -8301,7 +10490,7 @@ dwindle(Monitor *m)
 	uint32_t tags = m->tagset[m->seltags];
 	
 	/* Create dwindle nodes for any tiled clients that don't have one */
-	wl_list_for_each(c, &clients, link) {
+	wl_list_for_each(c, &m->clients, mlink) {
 		if (VISIBLEON(c, m) && !c->isfloating && !c->isfullscreen && !c->dwindle) {
 			dwindle_create(c);
 		}
@@ -8336,7 +10525,11 @@ toggletag(const Arg *arg)
 	if (!sel || !(newtags = sel->tags ^ (arg->ui & TAGMASK)))
 		return;
 
+	/* Its dwindle tree belongs to the old tags */
+	dwindle_remove(sel);
+	clientcount(sel, -1);
 	sel->tags = newtags;
+	clientcount(sel, 1);
 	focusclient(focustop(selmon), 1);
 	arrange(selmon);
 	printstatus();
@@ -8350,6 +10543,7 @@ toggleview(const Arg *arg)
 		return;
 
 	selmon->tagset[selmon->seltags] = newtagset;
+	recountvisible(selmon);
 	focusclient(focustop(selmon), 1);
 	arrange(selmon);
 	printstatus();
@@ -8386,6 +10580,7 @@ unmapnotify(struct wl_listener *listener, void *data)
 	if (c == grabc) {
 		cursor_mode = CurNormal;
 		grabc = NULL;
+		grab_pending = 0;
 	}
 
 	if (client_is_unmanaged(c)) {
@@ -8404,12 +10599,9 @@ unmapnotify(struct wl_listener *listener, void *data)
 	/* Clear frame buffers before destroying scene to prevent leaks */
 	if (c->frame_top)
 		wlr_scene_buffer_set_buffer(c->frame_top, NULL);
-	if (c->frame_bottom)
-		wlr_scene_buffer_set_buffer(c->frame_bottom, NULL);
-	if (c->frame_left)
-		wlr_scene_buffer_set_buffer(c->frame_left, NULL);
-	if (c->frame_right)
-		wlr_scene_buffer_set_buffer(c->frame_right, NULL);
+	frame_set_side(c, &c->frame_bottom, &c->frame_bottom_strip, NULL, 0, 0);
+	frame_set_side(c, &c->frame_left, &c->frame_left_strip, NULL, 0, 0);
+	frame_set_side(c, &c->frame_right, &c->frame_right_strip, NULL, 0, 0);
 
 	/* Free cached frame buffers */
 	/* Drop our buffer references - scene already released via set_buffer(NULL) above */
@@ -8417,18 +10609,8 @@ unmapnotify(struct wl_listener *listener, void *data)
 		wlr_buffer_drop(&c->frame_top_buf->base);
 		c->frame_top_buf = NULL;
 	}
-	if (c->frame_bottom_buf) {
-		wlr_buffer_drop(&c->frame_bottom_buf->base);
-		c->frame_bottom_buf = NULL;
-	}
-	if (c->frame_left_buf) {
-		wlr_buffer_drop(&c->frame_left_buf->base);
-		c->frame_left_buf = NULL;
-	}
-	if (c->frame_right_buf) {
-		wlr_buffer_drop(&c->frame_right_buf->base);
-		c->frame_right_buf = NULL;
-	}
+	marquee_destroy(&c->title_marquee);
+	atlastext_destroy(&c->title_text);
 
 	wlr_scene_node_destroy(&c->scene->node);
 	printstatus();
@@ -8504,6 +10686,7 @@ updatemons(struct wl_listener *listener, void *data)
 		/* Reserve space for status bar at top (after arrangelayers) */
 		m->w.y += cell_height;
 		m->w.height -= cell_height;
+		updateuifilter(m);
 		updatebar(m);
 		/* Don't move clients to the left output when plugging monitors */
 		arrange(m);
@@ -8599,6 +10782,7 @@ view(const Arg *arg)
 	selmon->seltags ^= 1; /* toggle sel tagset */
 	if (arg->ui & TAGMASK)
 		selmon->tagset[selmon->seltags] = arg->ui & TAGMASK;
+	recountvisible(selmon);
 	focusclient(focustop(selmon), 1);
 	arrange(selmon);
 	printstatus();
@@ -8681,7 +10865,7 @@ zoom(const Arg *arg)
 
 	/* Search for the first tiled window that is not sel, marking sel as
 	 * NULL if we pass it along the way */
-	wl_list_for_each(c, &clients, link) {
+	wl_list_for_each(c, &selmon->clients, mlink) {
 		if (VISIBLEON(c, selmon) && !c->isfloating) {
 			if (c != sel)
 				break;
@@ -8690,7 +10874,7 @@ zoom(const Arg *arg)
 	}
 
 	/* Return if no other tiled window was found */
-	if (&c->link == &clients)
+	if (&c->mlink == &selmon->clients)
 		return;
 
 	/* If we passed sel, move c to the front; otherwise, move sel to the
@@ -8699,6 +10883,8 @@ zoom(const Arg *arg)
 		sel = c;
 	wl_list_remove(&sel->link);
 	wl_list_insert(&clients, &sel->link);
+	wl_list_remove(&sel->mlink);
+	wl_list_insert(&selmon->clients, &sel->mlink);
 
 	focusclient(sel, 1);
 	arrange(selmon);
@@ -8745,6 +10931,10 @@ configurex11(struct wl_listener *listener, void *data)
 				.y = event->y - c->bw, .width = event->width + c->bw * 2,
 				.height = event->height + c->bw * 2}, 0);
 	} else {
+		/* The layout won't move it, but the request still needs an answer:
+		 * make layout_commit() and resize() send the current box again */
+		c->req_valid = 0;
+		c->sized_valid = 0;
 		arrange(c->mon);
 	}
 }
@@ -8821,8 +11011,10 @@ main(int argc, char *argv[])
 	while ((c = getopt(argc, argv, "s:hdv")) != -1) {
 		if (c == 's')
 			startup_cmd = optarg;
-		else if (c == 'd')
+		else if (c == 'd') {
 			log_level = WLR_DEBUG;
+			cfg_file_log_level = TBWM_LOG_DEBUG;
+		}
 		else if (c == 'v')
 			die("tbwm " VERSION);
 		else